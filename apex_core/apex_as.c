@@ -0,0 +1,254 @@
+/*
+ * apex_as.c
+ * apex-as: assembles one program of an input file into a program image
+ * (.apexbin) that apex_sim and the batch, sweep and selfbench modes load
+ * like the input file, without parsing any text.
+ *
+ * File layout, host byte order, see APEX_Binary_Header:
+ *
+ *   APEX_Binary_Header
+ *   APEX_Binary_Insn, insn_count of them, in code memory order
+ *   APEX_Binary_Data, data_count of them
+ *   APEX_Binary_Symbol, symbol_count of them
+ *
+ * The symbol table names the program at PC 4000 after its ---TC n---
+ * header, as batch reports it. The data memory words come from a file of
+ * "address value" lines given with the data option; # starts a comment.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_cpu.h"
+#include "apex_macros.h"
+
+/* Reads the "address value" lines of path. Returns their number, or -1 if
+ * the file can not be read or has a malformed line */
+static int
+read_data_file(const char *path, APEX_Binary_Data **data)
+{
+    APEX_Binary_Data *grown;
+    FILE *fp;
+    size_t len = 0;
+    char *line = NULL;
+    char rest[2];
+    int addr, value, fields;
+    int capacity = 0;
+    int count = 0;
+    int line_num = 0;
+
+    *data = NULL;
+    fp = fopen(path, "r");
+    if (!fp)
+    {
+        fprintf(stderr, "APEX_Error: Unable to open %s\n", path);
+        return -1;
+    }
+
+    while (getline(&line, &len, fp) != -1)
+    {
+        line_num++;
+        line[strcspn(line, "#")] = '\0';
+        fields = sscanf(line, "%i %i %1s", &addr, &value, rest);
+        if (fields <= 0)
+        {
+            continue;
+        }
+        if (fields != 2 || addr < 0 || addr >= DATA_MEMORY_SIZE)
+        {
+            fprintf(stderr, "APEX_Error: %s line %d: expected an address in 0-%d and a value\n",
+                    path, line_num, DATA_MEMORY_SIZE - 1);
+            count = -1;
+            break;
+        }
+
+        if (count == capacity)
+        {
+            capacity = capacity ? 2 * capacity : 64;
+            grown = realloc(*data, capacity * sizeof(APEX_Binary_Data));
+            if (!grown)
+            {
+                count = -1;
+                break;
+            }
+            *data = grown;
+        }
+        (*data)[count].addr = addr;
+        (*data)[count].value = value;
+        count++;
+    }
+
+    if (count < 0)
+    {
+        free(*data);
+        *data = NULL;
+    }
+    free(line);
+    fclose(fp);
+    return count;
+}
+
+/* Input path with .asm replaced by .apexbin */
+static char *
+default_output(const char *input)
+{
+    size_t len = strlen(input);
+    char *output = malloc(len + sizeof(".apexbin"));
+
+    if (!output)
+    {
+        return NULL;
+    }
+    if (len > 4 && strcmp(input + len - 4, ".asm") == 0)
+    {
+        len -= 4;
+    }
+    memcpy(output, input, len);
+    strcpy(output + len, ".apexbin");
+    return output;
+}
+
+static int
+write_image(const char *path, const APEX_Instruction *code_memory, int size,
+            const APEX_Binary_Data *data, int data_count, const char *name)
+{
+    APEX_Binary_Header header;
+    APEX_Binary_Symbol symbol;
+    APEX_Binary_Insn insn;
+    FILE *fp;
+    int i;
+
+    fp = fopen(path, "wb");
+    if (!fp)
+    {
+        return -1;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BINARY_MAGIC, sizeof(header.magic));
+    header.version = BINARY_VERSION;
+    header.header_size = sizeof(header);
+    header.insn_size = sizeof(APEX_Binary_Insn);
+    header.insn_count = size;
+    header.data_count = data_count;
+    header.symbol_count = name[0] ? 1 : 0;
+    fwrite(&header, sizeof(header), 1, fp);
+
+    for (i = 0; i < size; ++i)
+    {
+        memset(&insn, 0, sizeof(insn));
+        insn.opcode = code_memory[i].opcode;
+        insn.rd = code_memory[i].rd;
+        insn.rs1 = code_memory[i].rs1;
+        insn.rs2 = code_memory[i].rs2;
+        insn.imm = code_memory[i].imm;
+        fwrite(&insn, sizeof(insn), 1, fp);
+    }
+
+    fwrite(data, sizeof(APEX_Binary_Data), data_count, fp);
+
+    if (name[0])
+    {
+        memset(&symbol, 0, sizeof(symbol));
+        symbol.addr = 4000;
+        snprintf(symbol.name, sizeof(symbol.name), "%s", name);
+        fwrite(&symbol, sizeof(symbol), 1, fp);
+    }
+
+    if (ferror(fp))
+    {
+        fclose(fp);
+        return -1;
+    }
+    return fclose(fp) == 0 ? 0 : -1;
+}
+
+int
+main(int argc, char const *argv[])
+{
+    APEX_Instruction *code_memory;
+    APEX_Binary_Data *data = NULL;
+    char(*names)[SECTION_NAME_SIZE];
+    const char *data_file = NULL;
+    char *output = NULL;
+    int program = 1;
+    int size, sections, data_count = 0;
+    int ret = 0;
+    int i;
+
+    if (argc < 2 || argc % 2 != 0)
+    {
+        fprintf(stderr, "APEX_Help: Usage %s <input_file> [output <file>] [program <n>] "
+                        "[data <file>]\n",
+                argv[0]);
+        exit(1);
+    }
+    for (i = 2; i < argc; i += 2)
+    {
+        if (strcmp(argv[i], "output") == 0)
+        {
+            free(output);
+            output = strdup(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "program") == 0)
+        {
+            program = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "data") == 0)
+        {
+            data_file = argv[i + 1];
+        }
+        else
+        {
+            fprintf(stderr, "APEX_Help: Usage %s <input_file> [output <file>] [program <n>] "
+                            "[data <file>]\n",
+                    argv[0]);
+            exit(1);
+        }
+    }
+    if (!output)
+    {
+        output = default_output(argv[1]);
+    }
+
+    /* Programs of a multi-program file are counted from 1 */
+    sections = get_code_sections(argv[1], NULL, 0);
+    if (sections < 0 || program < 1 || program > sections)
+    {
+        fprintf(stderr, "APEX_Error: %s has no program %d\n", argv[1], program);
+        exit(1);
+    }
+    names = calloc(sections, SECTION_NAME_SIZE);
+    code_memory = create_code_memory(argv[1], program - 1, &size);
+    if (!names || !code_memory || !output)
+    {
+        fprintf(stderr, "APEX_Error: Unable to assemble %s\n", argv[1]);
+        exit(1);
+    }
+    get_code_sections(argv[1], names, sections);
+
+    if (data_file)
+    {
+        data_count = read_data_file(data_file, &data);
+        if (data_count < 0)
+        {
+            exit(1);
+        }
+    }
+
+    if (write_image(output, code_memory, size, data, data_count, names[program - 1]) != 0)
+    {
+        fprintf(stderr, "APEX_Error: Unable to write %s\n", output);
+        ret = 1;
+    }
+    else
+    {
+        printf("APEX_AS: %s: %d instructions, %d data words\n", output, size, data_count);
+    }
+
+    free(data);
+    free(names);
+    free(code_memory);
+    free(output);
+    return ret;
+}
@@ -0,0 +1,481 @@
+/*
+ * apex_batch.c
+ * Contains the batch runner: simulates many programs, each in its own
+ * silent APEX_CPU, on a pool of host threads, and prints one summary line
+ * per program. The program list and the thread pool are shared with the
+ * configuration sweep
+ */
+#include <dirent.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_cpu.h"
+#include "apex_macros.h"
+
+/* Outcome of one program */
+#define BATCH_HALTED 0x0
+#define BATCH_TIMEOUT 0x1
+#define BATCH_LOAD_ERROR 0x2
+
+typedef struct Batch_Result
+{
+    int status;            /* BATCH_* */
+    int cycles;
+    int insns;
+    int regs[REG_FILE_SIZE];
+    uint64_t mem_hash;     /* FNV-1a of data memory */
+} Batch_Result;
+
+typedef struct Batch
+{
+    APEX_Program *programs;
+    Batch_Result *results;
+    int count;
+    int hazard;            /* HAZARD_* policy of every CPU */
+    int max_cycles;
+} Batch;
+
+/* Program list being collected */
+typedef struct Program_List
+{
+    APEX_Program *programs;
+    int count;
+    int capacity;
+} Program_List;
+
+/* Work shared by the threads of APEX_run_parallel */
+typedef struct Parallel_Work
+{
+    void (*job)(void *arg, int i);
+    void *arg;
+    int count;
+    int next;              /* Next job to claim */
+} Parallel_Work;
+
+static uint64_t
+hash_data_memory(const APEX_CPU *cpu)
+{
+    const unsigned char *p = (const unsigned char *)cpu->data_memory;
+    uint64_t hash = 14695981039346656037ULL;
+    size_t i;
+
+    for (i = 0; i < sizeof(cpu->data_memory); ++i)
+    {
+        hash = (hash ^ p[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+static void
+run_program(void *arg, int i)
+{
+    Batch *batch = arg;
+    Batch_Result *result = &batch->results[i];
+    APEX_CPU *cpu = APEX_cpu_create(batch->programs[i].path, batch->programs[i].section, NULL);
+
+    if (!cpu)
+    {
+        result->status = BATCH_LOAD_ERROR;
+        return;
+    }
+    APEX_cpu_set_hazard(cpu, batch->hazard);
+
+    result->status =
+        APEX_cpu_step_until(cpu, batch->max_cycles) ? BATCH_HALTED : BATCH_TIMEOUT;
+
+    result->cycles = cpu->clock;
+    result->insns = cpu->insn_completed;
+    memcpy(result->regs, cpu->regs, sizeof(result->regs));
+    result->mem_hash = hash_data_memory(cpu);
+    APEX_cpu_stop(cpu);
+}
+
+/* Each worker claims the next unstarted job until none are left, so idle
+ * threads pick up work as soon as they finish */
+static void *
+parallel_worker(void *arg)
+{
+    Parallel_Work *work = arg;
+    int i;
+
+    while ((i = __atomic_fetch_add(&work->next, 1, __ATOMIC_RELAXED)) < work->count)
+    {
+        work->job(work->arg, i);
+    }
+    return NULL;
+}
+
+/*
+ * Calls job(arg, i) for every i in [0, count) on up to threads host
+ * threads, and returns once all calls have returned
+ */
+void
+APEX_run_parallel(int count, int threads, void (*job)(void *arg, int i), void *arg)
+{
+    Parallel_Work work = {job, arg, count, 0};
+    pthread_t *workers = calloc(threads > 0 ? threads : 1, sizeof(pthread_t));
+    int started = 0;
+    int i;
+
+    for (i = 0; workers && i < threads && i < count; ++i)
+    {
+        if (pthread_create(&workers[i], NULL, parallel_worker, &work) != 0)
+        {
+            break;
+        }
+        started++;
+    }
+    /* Run in this thread if no worker could be started */
+    if (!started)
+    {
+        parallel_worker(&work);
+    }
+    for (i = 0; i < started; ++i)
+    {
+        pthread_join(workers[i], NULL);
+    }
+    free(workers);
+}
+
+static int
+add_section(Program_List *list, const char *path, int section, const char *name)
+{
+    APEX_Program *grown;
+    APEX_Program *program;
+
+    if (list->count == list->capacity)
+    {
+        list->capacity = list->capacity ? 2 * list->capacity : 64;
+        grown = realloc(list->programs, list->capacity * sizeof(APEX_Program));
+        if (!grown)
+        {
+            return -1;
+        }
+        list->programs = grown;
+    }
+
+    program = &list->programs[list->count];
+    memset(program, 0, sizeof(APEX_Program));
+    program->path = strdup(path);
+    if (!program->path)
+    {
+        return -1;
+    }
+    program->section = section;
+    snprintf(program->name, sizeof(program->name), "%s", name);
+    list->count++;
+    return 0;
+}
+
+/* Adds every program section of the file, so each test case of a file
+ * such as test_cases.asm runs on its own */
+static int
+add_program(Program_List *list, const char *dir, const char *name)
+{
+    char (*names)[SECTION_NAME_SIZE] = NULL;
+    char label[SECTION_NAME_SIZE];
+    char *path;
+    int sections, i;
+    int ret = 0;
+
+    if (dir && name[0] != '/')
+    {
+        path = malloc(strlen(dir) + strlen(name) + 2);
+        if (path)
+        {
+            sprintf(path, "%s/%s", dir, name);
+        }
+    }
+    else
+    {
+        path = strdup(name);
+    }
+    if (!path)
+    {
+        return -1;
+    }
+
+    sections = get_code_sections(path, NULL, 0);
+    if (sections > 1)
+    {
+        names = calloc(sections, SECTION_NAME_SIZE);
+    }
+    if (!names)
+    {
+        /* A single program, or a file that fails to load */
+        ret = add_section(list, path, 0, "");
+        free(path);
+        return ret;
+    }
+
+    get_code_sections(path, names, sections);
+    for (i = 0; i < sections && ret == 0; ++i)
+    {
+        if (names[i][0])
+        {
+            snprintf(label, sizeof(label), "%s", names[i]);
+        }
+        else
+        {
+            snprintf(label, sizeof(label), "#%d", i + 1);
+        }
+        ret = add_section(list, path, i, label);
+    }
+
+    free(names);
+    free(path);
+    return ret;
+}
+
+static int
+compare_names(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/* An .asm input file or an .apexbin program image */
+static int
+is_program_file(const char *name)
+{
+    size_t len = strlen(name);
+
+    return (len > 4 && strcmp(name + len - 4, ".asm") == 0)
+           || (len > 8 && strcmp(name + len - 8, ".apexbin") == 0);
+}
+
+/* Every .asm and .apexbin file of a directory, in name order */
+static int
+collect_directory(Program_List *list, const char *source, DIR *dir)
+{
+    struct dirent *entry;
+    char **names = NULL;
+    char **grown;
+    int count = 0;
+    int i, ret = 0;
+
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (!is_program_file(entry->d_name))
+        {
+            continue;
+        }
+        grown = realloc(names, (count + 1) * sizeof(char *));
+        if (!grown || !(grown[count] = strdup(entry->d_name)))
+        {
+            names = grown ? grown : names;
+            ret = -1;
+            break;
+        }
+        names = grown;
+        count++;
+    }
+    qsort(names, count, sizeof(char *), compare_names);
+
+    for (i = 0; i < count; ++i)
+    {
+        if (ret == 0)
+        {
+            ret = add_program(list, source, names[i]);
+        }
+        free(names[i]);
+    }
+    free(names);
+    return ret;
+}
+
+/* One program per line of a manifest, relative to the manifest's directory.
+ * Blank lines and lines starting with # are skipped */
+static int
+collect_manifest(Program_List *list, const char *source)
+{
+    FILE *fp = fopen(source, "r");
+    char *line = NULL;
+    size_t len = 0;
+    char *dir, *slash;
+    int ret = 0;
+
+    if (!fp)
+    {
+        return -1;
+    }
+
+    dir = strdup(source);
+    slash = dir ? strrchr(dir, '/') : NULL;
+    if (slash)
+    {
+        *slash = '\0';
+    }
+
+    while (getline(&line, &len, fp) != -1)
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#')
+        {
+            continue;
+        }
+        if (add_program(list, slash ? dir : NULL, line) != 0)
+        {
+            ret = -1;
+            break;
+        }
+    }
+
+    free(line);
+    free(dir);
+    fclose(fp);
+    return ret;
+}
+
+static void
+print_results(const Batch *batch, FILE *out)
+{
+    const Batch_Result *r;
+    static const char *status[] = {"HALT", "TIMEOUT", "ERROR"};
+    char program[256];
+    int i, j;
+
+    fprintf(out, "%-32s %-8s %10s %10s %8s %-18s %s\n", "program", "status", "cycles",
+            "insns", "CPI", "mem_hash", "registers");
+    for (i = 0; i < batch->count; ++i)
+    {
+        r = &batch->results[i];
+        APEX_program_label(&batch->programs[i], program, sizeof(program));
+
+        if (r->status == BATCH_LOAD_ERROR)
+        {
+            fprintf(out, "%-32s %-8s\n", program, status[r->status]);
+            continue;
+        }
+
+        fprintf(out, "%-32s %-8s %10d %10d %8.3f 0x%016llx", program, status[r->status],
+                r->cycles, r->insns, r->insns ? (double)r->cycles / r->insns : 0.0,
+                (unsigned long long)r->mem_hash);
+        /* Registers still zero are left out */
+        for (j = 0; j < REG_FILE_SIZE; ++j)
+        {
+            if (r->regs[j])
+            {
+                fprintf(out, " R%d=%d", j, r->regs[j]);
+            }
+        }
+        fprintf(out, "\n");
+    }
+}
+
+/* Writes "path [section]" for a program of a multi-program file, else path */
+void
+APEX_program_label(const APEX_Program *program, char *buf, size_t size)
+{
+    if (program->name[0])
+    {
+        snprintf(buf, size, "%s [%s]", program->path, program->name);
+    }
+    else
+    {
+        snprintf(buf, size, "%s", program->path);
+    }
+}
+
+/*
+ * Lists the programs in source, a directory of .asm and .apexbin files, a
+ * manifest or a single such file. Every ---TC n--- section of a file is a
+ * program.
+ *
+ * Returns the number of programs, stored in *programs, or -1 if source can
+ * not be read
+ */
+int
+APEX_batch_collect(const char *source, APEX_Program **programs)
+{
+    Program_List list;
+    DIR *dir;
+    int ret;
+
+    memset(&list, 0, sizeof(list));
+    dir = opendir(source);
+    if (dir)
+    {
+        ret = collect_directory(&list, source, dir);
+        closedir(dir);
+    }
+    else if (is_program_file(source))
+    {
+        ret = add_program(&list, NULL, source);
+    }
+    else
+    {
+        ret = collect_manifest(&list, source);
+    }
+
+    if (ret != 0)
+    {
+        APEX_batch_free(list.programs, list.count);
+        return -1;
+    }
+    *programs = list.programs;
+    return list.count;
+}
+
+void
+APEX_batch_free(APEX_Program *programs, int count)
+{
+    int i;
+
+    for (i = 0; i < count; ++i)
+    {
+        free(programs[i].path);
+    }
+    free(programs);
+}
+
+/*
+ * Simulates every program listed in source (see APEX_batch_collect) with
+ * the hazard policy hazard, for at most max_cycles cycles each, on threads
+ * host threads, and prints the summary to out in input order.
+ *
+ * Returns the number of programs that did not halt, or -1 if source can
+ * not be read.
+ */
+int
+APEX_batch_run(const char *source, int hazard, int threads, int max_cycles, FILE *out)
+{
+    Batch batch;
+    int failed = 0;
+    int i;
+
+    memset(&batch, 0, sizeof(batch));
+    batch.hazard = hazard;
+    batch.max_cycles = max_cycles;
+    batch.count = APEX_batch_collect(source, &batch.programs);
+    if (batch.count < 0)
+    {
+        return -1;
+    }
+
+    batch.results = calloc(batch.count ? batch.count : 1, sizeof(Batch_Result));
+    if (!batch.results)
+    {
+        APEX_batch_free(batch.programs, batch.count);
+        return -1;
+    }
+
+    APEX_run_parallel(batch.count, threads, run_program, &batch);
+
+    print_results(&batch, out);
+    for (i = 0; i < batch.count; ++i)
+    {
+        if (batch.results[i].status != BATCH_HALTED)
+        {
+            failed++;
+        }
+    }
+    fprintf(out, "APEX_CPU: Batch complete, programs = %d halted = %d failed = %d\n",
+            batch.count, batch.count - failed, failed);
+
+    APEX_batch_free(batch.programs, batch.count);
+    free(batch.results);
+    return failed;
+}
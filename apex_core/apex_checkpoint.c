@@ -0,0 +1,330 @@
+/*
+ * apex_checkpoint.c
+ * Contains save and restore of the complete APEX_CPU state, so a run can be
+ * resumed mid-program with exactly the same timing as an uninterrupted run
+ *
+ * File layout, host byte order, every field naturally aligned so the file
+ * can be mapped and read in place:
+ *
+ *   APEX_Checkpoint_Header
+ *   APEX_Checkpoint_State
+ *   input file path, program_len bytes, not NUL terminated
+ */
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "apex_cpu.h"
+#include "apex_macros.h"
+
+#define CHECKPOINT_MAGIC "APEXCKPT"
+#define CHECKPOINT_VERSION 4
+#define CHECKPOINT_NUM_STAGES 5
+
+typedef struct APEX_Checkpoint_Header
+{
+    char magic[8];             /* CHECKPOINT_MAGIC */
+    uint32_t version;          /* CHECKPOINT_VERSION */
+    uint32_t header_size;      /* sizeof(APEX_Checkpoint_Header) */
+    uint32_t state_size;       /* sizeof(APEX_Checkpoint_State) */
+    uint32_t program_len;      /* Length of the input file path */
+    uint64_t code_hash;        /* hash_code_memory() of the program */
+    int32_t code_memory_size;
+    uint32_t reserved;
+} APEX_Checkpoint_Header;
+
+/* CPU_Stage with the instruction pointer replaced by a code memory index */
+typedef struct APEX_Checkpoint_Stage
+{
+    int32_t insn_index;        /* -1 when the latch never held an instruction */
+    int32_t pc;
+    int32_t rs1_value;
+    int32_t rs2_value;
+    int32_t result_buffer;
+    int32_t memory_address;
+    uint8_t has_insn;
+    uint8_t cycles_left;
+    uint8_t reserved[2];
+} APEX_Checkpoint_Stage;
+
+typedef struct APEX_Checkpoint_State
+{
+    int64_t functional_insns;
+    uint64_t latch_copy_bytes;
+    int32_t pc;
+    int32_t clock;
+    int32_t insn_completed;
+    int32_t stall_pipeline;
+    int32_t stall_cycles;
+    int32_t fetch_from_next_cycle;
+    int32_t fetch_before_stall;
+    int32_t zero_flag;
+    int32_t positive_flag;
+    int32_t negative_flag;
+    int32_t hazard;
+    int32_t bypass[6];
+    int32_t regs[REG_FILE_SIZE];
+    int32_t regs_state[REG_FILE_SIZE];
+    int32_t data_memory[DATA_MEMORY_SIZE];
+    APEX_Checkpoint_Stage stages[CHECKPOINT_NUM_STAGES];
+    uint8_t latency[NUM_OPCODES];      /* Execute cycles per opcode, see sweep */
+} APEX_Checkpoint_State;
+
+_Static_assert(sizeof(CPU_Bypass) == sizeof(((APEX_Checkpoint_State *)0)->bypass),
+               "checkpoint bypass layout out of date");
+
+/* FNV-1a over the decoded fields of every instruction, identifies the
+ * program a checkpoint was taken from */
+static uint64_t
+hash_code_memory(const APEX_CPU *cpu)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    int32_t fields[5];
+    const unsigned char *p;
+    size_t j;
+    int i;
+
+    for (i = 0; i < cpu->code_memory_size; ++i)
+    {
+        const APEX_Instruction *insn = &cpu->code_memory[i];
+
+        fields[0] = insn->opcode;
+        fields[1] = insn->rd;
+        fields[2] = insn->rs1;
+        fields[3] = insn->rs2;
+        fields[4] = insn->imm;
+        p = (const unsigned char *)fields;
+        for (j = 0; j < sizeof(fields); ++j)
+        {
+            hash = (hash ^ p[j]) * 1099511628211ULL;
+        }
+    }
+    return hash;
+}
+
+static CPU_Stage *
+cpu_stage(APEX_CPU *cpu, int i)
+{
+    CPU_Stage *stages[CHECKPOINT_NUM_STAGES] = {
+        &cpu->fetch, &cpu->decode, &cpu->execute, &cpu->memory, &cpu->writeback};
+
+    return stages[i];
+}
+
+/*
+ * Writes the state of cpu to path. Returns 0 on success, -1 on failure.
+ */
+int
+APEX_cpu_save(APEX_CPU *cpu, const char *path)
+{
+    APEX_Checkpoint_Header header;
+    APEX_Checkpoint_State *state;
+    FILE *fp;
+    int i, ok;
+
+    state = calloc(1, sizeof(*state));
+    if (!state)
+    {
+        return -1;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = CHECKPOINT_VERSION;
+    header.header_size = sizeof(header);
+    header.state_size = sizeof(*state);
+    header.program_len = strlen(cpu->filename);
+    header.code_hash = hash_code_memory(cpu);
+    header.code_memory_size = cpu->code_memory_size;
+
+    state->functional_insns = cpu->functional_insns;
+    state->latch_copy_bytes = cpu->latch_copy_bytes;
+    state->pc = cpu->pc;
+    state->clock = cpu->clock;
+    state->insn_completed = cpu->insn_completed;
+    state->stall_pipeline = cpu->stall_pipeline;
+    state->stall_cycles = cpu->stall_cycles;
+    state->fetch_from_next_cycle = cpu->fetch_from_next_cycle;
+    state->fetch_before_stall = cpu->fetch_before_stall;
+    state->zero_flag = cpu->zero_flag;
+    state->positive_flag = cpu->positive_flag;
+    state->negative_flag = cpu->negative_flag;
+    state->hazard = cpu->hazard;
+    memcpy(state->bypass, &cpu->bypass, sizeof(state->bypass));
+    memcpy(state->regs, cpu->regs, sizeof(state->regs));
+    memcpy(state->regs_state, cpu->regs_state, sizeof(state->regs_state));
+    memcpy(state->data_memory, cpu->data_memory, sizeof(state->data_memory));
+    memcpy(state->latency, cpu->latency, sizeof(state->latency));
+
+    for (i = 0; i < CHECKPOINT_NUM_STAGES; ++i)
+    {
+        const CPU_Stage *stage = cpu_stage(cpu, i);
+        APEX_Checkpoint_Stage *saved = &state->stages[i];
+
+        saved->insn_index = stage->insn ? (int32_t)(stage->insn - cpu->code_memory) : -1;
+        saved->pc = stage->pc;
+        saved->rs1_value = stage->rs1_value;
+        saved->rs2_value = stage->rs2_value;
+        saved->result_buffer = stage->result_buffer;
+        saved->memory_address = stage->memory_address;
+        saved->has_insn = stage->has_insn;
+        saved->cycles_left = stage->cycles_left;
+    }
+
+    fp = fopen(path, "wb");
+    if (!fp)
+    {
+        free(state);
+        return -1;
+    }
+
+    ok = fwrite(&header, sizeof(header), 1, fp) == 1
+         && fwrite(state, sizeof(*state), 1, fp) == 1
+         && fwrite(cpu->filename, 1, header.program_len, fp) == header.program_len;
+    ok = (fclose(fp) == 0) && ok;
+    free(state);
+    return ok ? 0 : -1;
+}
+
+/*
+ * Creates a CPU from a checkpoint written by APEX_cpu_save. The input file
+ * recorded in the checkpoint is parsed again and must not have changed.
+ * Returns NULL, with a message on stderr, if the checkpoint can not be used.
+ */
+APEX_CPU *
+APEX_cpu_restore(const char *path)
+{
+    const APEX_Checkpoint_Header *header;
+    const APEX_Checkpoint_State *state;
+    APEX_CPU *cpu = NULL;
+    struct stat st;
+    char *program = NULL;
+    void *map;
+    int fd, i;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        fprintf(stderr, "APEX_Error: Unable to open checkpoint %s\n", path);
+        return NULL;
+    }
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(*header))
+    {
+        fprintf(stderr, "APEX_Error: %s is not an APEX checkpoint\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        fprintf(stderr, "APEX_Error: Unable to map checkpoint %s\n", path);
+        return NULL;
+    }
+
+    header = map;
+    state = (const APEX_Checkpoint_State *)((const char *)map + sizeof(*header));
+
+    if (memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic)) != 0
+        || header->version != CHECKPOINT_VERSION
+        || header->header_size != sizeof(*header)
+        || header->state_size != sizeof(*state)
+        || (size_t)st.st_size != sizeof(*header) + sizeof(*state) + header->program_len)
+    {
+        fprintf(stderr, "APEX_Error: %s is not a version %d APEX checkpoint\n", path,
+                CHECKPOINT_VERSION);
+        goto out;
+    }
+
+    program = strndup((const char *)(state + 1), header->program_len);
+    if (!program)
+    {
+        goto out;
+    }
+
+    cpu = APEX_cpu_init(program);
+    if (!cpu)
+    {
+        fprintf(stderr, "APEX_Error: Unable to load %s from checkpoint\n", program);
+        goto out;
+    }
+
+    if (cpu->code_memory_size != header->code_memory_size
+        || hash_code_memory(cpu) != header->code_hash)
+    {
+        fprintf(stderr, "APEX_Error: %s has changed since the checkpoint was taken\n",
+                program);
+        APEX_cpu_stop(cpu);
+        cpu = NULL;
+        goto out;
+    }
+
+    for (i = 0; i < NUM_OPCODES; ++i)
+    {
+        if (APEX_get_opcode_info(i) && state->latency[i] == 0)
+        {
+            break;
+        }
+    }
+    if (state->hazard < 0 || state->hazard >= NUM_HAZARD_POLICIES || i < NUM_OPCODES)
+    {
+        fprintf(stderr, "APEX_Error: %s is corrupt\n", path);
+        APEX_cpu_stop(cpu);
+        cpu = NULL;
+        goto out;
+    }
+
+    /* The run continues under the policy and latencies it was saved with */
+    APEX_cpu_set_hazard(cpu, state->hazard);
+    cpu->functional_insns = state->functional_insns;
+    cpu->latch_copy_bytes = state->latch_copy_bytes;
+    cpu->pc = state->pc;
+    cpu->clock = state->clock;
+    cpu->insn_completed = state->insn_completed;
+    cpu->stall_pipeline = state->stall_pipeline;
+    cpu->stall_cycles = state->stall_cycles;
+    cpu->fetch_from_next_cycle = state->fetch_from_next_cycle;
+    cpu->fetch_before_stall = state->fetch_before_stall;
+    cpu->zero_flag = state->zero_flag;
+    cpu->positive_flag = state->positive_flag;
+    cpu->negative_flag = state->negative_flag;
+    memcpy(&cpu->bypass, state->bypass, sizeof(state->bypass));
+    memcpy(cpu->regs, state->regs, sizeof(state->regs));
+    memcpy(cpu->regs_state, state->regs_state, sizeof(state->regs_state));
+    memcpy(cpu->data_memory, state->data_memory, sizeof(state->data_memory));
+    memcpy(cpu->latency, state->latency, sizeof(state->latency));
+    APEX_cpu_index_memory(cpu);
+
+    for (i = 0; i < CHECKPOINT_NUM_STAGES; ++i)
+    {
+        CPU_Stage *stage = cpu_stage(cpu, i);
+        const APEX_Checkpoint_Stage *saved = &state->stages[i];
+
+        /* The entry at code_memory_size is the sentinel fetched past the end */
+        if (saved->insn_index < -1 || saved->insn_index > cpu->code_memory_size)
+        {
+            fprintf(stderr, "APEX_Error: %s is corrupt\n", path);
+            APEX_cpu_stop(cpu);
+            cpu = NULL;
+            goto out;
+        }
+        stage->insn = saved->insn_index < 0 ? NULL : &cpu->code_memory[saved->insn_index];
+        stage->pc = saved->pc;
+        stage->rs1_value = saved->rs1_value;
+        stage->rs2_value = saved->rs2_value;
+        stage->result_buffer = saved->result_buffer;
+        stage->memory_address = saved->memory_address;
+        stage->has_insn = saved->has_insn;
+        stage->cycles_left = saved->cycles_left;
+    }
+
+out:
+    free(program);
+    munmap(map, st.st_size);
+    return cpu;
+}
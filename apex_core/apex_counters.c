@@ -0,0 +1,110 @@
+/*
+ * apex_counters.c
+ * Contains the export of the pipeline performance counters (APEX_Counters)
+ * as a JSON object:
+ *
+ *   {
+ *     "program": "input.asm", "pipeline": "forwarding", "halted": true,
+ *     "cycles": 35, "instructions": 29,
+ *     "stall_cycles": {"raw": 4, "load_use": 2, "flags": 0, "execute_busy": 0},
+ *     "forwarding": {"memory_latch": 9, "writeback_latch": 3},
+ *     "branch_flushes": 2, "squashed_fetches": 2,
+ *     "retired": {"MOVC": 6, "ADD": 12, ...},
+ *     "bubbles": {"fetch": 3, "decode": 5, "execute": 4, "memory": 7, "writeback": 8}
+ *   }
+ *
+ * retired lists only the opcodes that retired.
+ */
+#include <stdio.h>
+
+#include "apex_cpu.h"
+#include "apex_macros.h"
+
+static const char *const stall_cause_names[NUM_STALL_CAUSES] = {
+    [STALL_CAUSE_RAW] = "raw",
+    [STALL_CAUSE_LOAD_USE] = "load_use",
+    [STALL_CAUSE_FLAGS] = "flags",
+    [STALL_CAUSE_EXECUTE_BUSY] = "execute_busy",
+};
+
+static const char *const stage_keys[NUM_STAGES] = {
+    [STAGE_FETCH] = "fetch",
+    [STAGE_DECODE] = "decode",
+    [STAGE_EXECUTE] = "execute",
+    [STAGE_MEMORY] = "memory",
+    [STAGE_WRITEBACK] = "writeback",
+};
+
+/* Writes s as a JSON string */
+static void
+write_json_string(FILE *out, const char *s)
+{
+    fputc('"', out);
+    for (; *s; ++s)
+    {
+        if (*s == '"' || *s == '\\')
+        {
+            fprintf(out, "\\%c", *s);
+        }
+        else if ((unsigned char)*s < 0x20)
+        {
+            fprintf(out, "\\u%04x", (unsigned char)*s);
+        }
+        else
+        {
+            fputc(*s, out);
+        }
+    }
+    fputc('"', out);
+}
+
+/*
+ * Writes the counters of cpu as JSON to out, halted telling whether the
+ * run ended with HALT. Returns 0 on success, -1 if out could not be written
+ */
+int
+APEX_cpu_write_counters(const APEX_CPU *cpu, int halted, FILE *out)
+{
+    const APEX_Counters *c = &cpu->counters;
+    const char *sep = "";
+    int i;
+
+    fprintf(out, "{\n  \"program\": ");
+    write_json_string(out, cpu->filename);
+    fprintf(out, ",\n  \"pipeline\": \"%s\",\n  \"halted\": %s,\n", APEX_hazard_name(cpu->hazard),
+            halted ? "true" : "false");
+    fprintf(out, "  \"cycles\": %d,\n  \"instructions\": %d,\n", cpu->clock,
+            cpu->insn_completed);
+
+    fprintf(out, "  \"stall_cycles\": {");
+    for (i = 0; i < NUM_STALL_CAUSES; ++i)
+    {
+        fprintf(out, "%s\"%s\": %ld", i ? ", " : "", stall_cause_names[i], c->stalls[i]);
+    }
+    fprintf(out, "},\n");
+
+    fprintf(out, "  \"forwarding\": {\"memory_latch\": %ld, \"writeback_latch\": %ld},\n",
+            c->forward_memory, c->forward_writeback);
+    fprintf(out, "  \"branch_flushes\": %ld,\n  \"squashed_fetches\": %ld,\n", c->branch_flushes,
+            c->squashed_fetches);
+
+    fprintf(out, "  \"retired\": {");
+    for (i = 0; i < NUM_OPCODES; ++i)
+    {
+        if (c->retired[i] && get_opcode_name(i))
+        {
+            fprintf(out, "%s\"%s\": %ld", sep, get_opcode_name(i), c->retired[i]);
+            sep = ", ";
+        }
+    }
+    fprintf(out, "},\n");
+
+    fprintf(out, "  \"bubbles\": {");
+    for (i = 0; i < NUM_STAGES; ++i)
+    {
+        fprintf(out, "%s\"%s\": %ld", i ? ", " : "", stage_keys[i], c->bubbles[i]);
+    }
+    fprintf(out, "}\n}\n");
+
+    return ferror(out) ? -1 : 0;
+}
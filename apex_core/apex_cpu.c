@@ -0,0 +1,1839 @@
+/*
+ * apex_cpu.c
+ * Contains APEX cpu pipeline implementation
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_cpu.h"
+#include "apex_macros.h"
+
+/* Converts the PC(4000 series) into array index for code memory
+ *
+ * Note: You are not supposed to edit this function
+ */
+static int
+get_code_memory_index_from_pc(const int pc)
+{
+    return (pc - 4000) / 4;
+}
+
+_Static_assert(sizeof(CPU_Stage) <= 64, "CPU_Stage should fit in one cache line");
+
+/* Copies a pipeline latch into the next stage's latch */
+static void
+copy_latch(APEX_CPU *cpu, CPU_Stage *dst, const CPU_Stage *src)
+{
+    *dst = *src;
+
+    if (ENABLE_LATCH_STATS)
+    {
+        cpu->latch_copy_bytes += sizeof(CPU_Stage);
+    }
+}
+
+static void
+print_instruction(FILE *out, const CPU_Stage *stage)
+{
+    const APEX_Instruction *insn = stage->insn;
+    int i;
+
+    fprintf(out, "%s", insn->opcode_str);
+
+    /* Operands in assembly order, as described by the opcode table */
+    for (i = 0; i < 3; ++i)
+    {
+        switch (insn->info->operands[i])
+        {
+        case OPERAND_RD:
+        {
+            fprintf(out, ",R%d", insn->rd);
+            break;
+        }
+
+        case OPERAND_RS1:
+        {
+            fprintf(out, ",R%d", insn->rs1);
+            break;
+        }
+
+        case OPERAND_RS2:
+        {
+            fprintf(out, ",R%d", insn->rs2);
+            break;
+        }
+
+        case OPERAND_IMM:
+        {
+            fprintf(out, ",#%d", insn->imm);
+            break;
+        }
+        }
+    }
+}
+
+/* Debug function which prints the CPU stage content
+ *
+ * Note: You can edit this function to print in more detail
+ */
+static void
+print_stage_content(const APEX_CPU *cpu, const char *name, const CPU_Stage *stage)
+{
+    fprintf(cpu->out, "%-15s: pc(%d) ", name, stage->pc);
+    print_instruction(cpu->out, stage);
+    fprintf(cpu->out, "\n");
+}
+
+/* Debug function which prints the register file
+ *
+ * Note: You are not supposed to edit this function
+ */
+static void
+print_reg_file(const APEX_CPU *cpu)
+{
+    int i;
+
+    fprintf(cpu->out, "----------\n%s\n----------\n", "Registers:");
+
+    for (int i = 0; i < REG_FILE_SIZE / 2; ++i)
+    {
+        fprintf(cpu->out, "R%-3d[%-3d] ", i, cpu->regs[i]);
+    }
+
+    fprintf(cpu->out, "\n");
+
+    for (i = (REG_FILE_SIZE / 2); i < REG_FILE_SIZE; ++i)
+    {
+        fprintf(cpu->out, "R%-3d[%-3d] ", i, cpu->regs[i]);
+    }
+
+    fprintf(cpu->out, "\n");
+}
+
+static void
+print_data_memory(const APEX_CPU *cpu)
+{
+    int addr;
+
+    fprintf(cpu->out, "----------\n%s\n----------\n", "Data Memory:");
+
+    /* Only the words stored to can be nonzero */
+    for (int i = 0; i < cpu->mem_index_len; ++i)
+    {
+        addr = cpu->mem_index[i];
+        if(cpu->data_memory[addr]!=0){
+        fprintf(cpu->out, "%-3d[%-3d] ", addr, cpu->data_memory[addr]);
+        }
+    }
+
+    fprintf(cpu->out, "\n");
+}
+
+/* Words stored to since the last report, in the order of the stores */
+static void
+print_memory_delta(const APEX_CPU *cpu)
+{
+    int addr;
+
+    fprintf(cpu->out, "----------\n%s\n----------\n", "Data Memory Changes:");
+
+    for (int i = 0; i < cpu->mem_delta_len; ++i)
+    {
+        addr = cpu->mem_delta[i];
+        fprintf(cpu->out, "%-3d[%-3d] ", addr, cpu->data_memory[addr]);
+    }
+
+    fprintf(cpu->out, "\n");
+}
+
+_Static_assert(DATA_MEMORY_SIZE % 64 == 0 && DATA_MEMORY_SIZE <= 65536,
+               "mem_written and mem_index need DATA_MEMORY_SIZE in 64-word blocks up to 64K");
+
+/*
+ * Stores value at a data memory address and records the word, so the
+ * reports visit only the words stored to: the sorted index of every word
+ * stored to and the list of words stored to since the last report
+ */
+void
+APEX_cpu_store(APEX_CPU *cpu, int addr, int value)
+{
+    uint64_t bit = 1ULL << (addr & 63);
+    int i;
+
+    cpu->data_memory[addr] = value;
+
+    if (!(cpu->mem_changed[addr >> 6] & bit))
+    {
+        cpu->mem_changed[addr >> 6] |= bit;
+        cpu->mem_delta[cpu->mem_delta_len++] = addr;
+    }
+
+    if (!(cpu->mem_written[addr >> 6] & bit))
+    {
+        cpu->mem_written[addr >> 6] |= bit;
+        for (i = cpu->mem_index_len; i > 0 && cpu->mem_index[i - 1] > addr; --i)
+        {
+            cpu->mem_index[i] = cpu->mem_index[i - 1];
+        }
+        cpu->mem_index[i] = addr;
+        cpu->mem_index_len++;
+    }
+}
+
+/*
+ * Rebuilds the index of words stored to from the nonzero words of data
+ * memory, after it was written other than through APEX_cpu_store: by the
+ * functional model, from a checkpoint, from a lockstep lane or from a
+ * program image
+ */
+void
+APEX_cpu_index_memory(APEX_CPU *cpu)
+{
+    int addr;
+
+    memset(cpu->mem_written, 0, sizeof(cpu->mem_written));
+    cpu->mem_index_len = 0;
+    for (addr = 0; addr < DATA_MEMORY_SIZE; ++addr)
+    {
+        if (cpu->data_memory[addr])
+        {
+            cpu->mem_written[addr >> 6] |= 1ULL << (addr & 63);
+            cpu->mem_index[cpu->mem_index_len++] = addr;
+        }
+    }
+}
+
+static void
+clear_memory_delta(APEX_CPU *cpu)
+{
+    int addr;
+
+    for (int i = 0; i < cpu->mem_delta_len; ++i)
+    {
+        addr = cpu->mem_delta[i];
+        cpu->mem_changed[addr >> 6] &= ~(1ULL << (addr & 63));
+    }
+    cpu->mem_delta_len = 0;
+}
+
+static void
+print_flag_values(const APEX_CPU *cpu)
+{
+    fprintf(cpu->out, "----------\n%s\n----------\n", "Flags:");
+
+    fprintf(cpu->out, "P->[%d], Z->[%d], N->[%d]", cpu->positive_flag, cpu->zero_flag, cpu->negative_flag);
+
+    fprintf(cpu->out, "\n");
+}
+
+static const char *const apex_stage_names[NUM_STAGES] = {
+    [STAGE_FETCH] = "Fetch",
+    [STAGE_DECODE] = "Decode/RF",
+    [STAGE_EXECUTE] = "Execute",
+    [STAGE_MEMORY] = "Memory",
+    [STAGE_WRITEBACK] = "Writeback",
+};
+
+/* Shows the instruction in a pipeline latch: as text at LOG_PIPELINE, as
+ * an event on a traced CPU */
+static void
+report_stage(APEX_CPU *cpu, int id, const CPU_Stage *stage)
+{
+    if (cpu->trace)
+    {
+        APEX_trace_stage(cpu->trace, cpu, id, stage);
+    }
+    if (cpu->log_level >= LOG_PIPELINE)
+    {
+        print_stage_content(cpu, apex_stage_names[id], stage);
+    }
+}
+
+/* Prints the latch of a STAGE_* stage as the simulation does, used by the
+ * trace decoder */
+void
+APEX_cpu_print_stage(const APEX_CPU *cpu, int stage)
+{
+    const CPU_Stage *latches[NUM_STAGES] = {
+        &cpu->fetch, &cpu->decode, &cpu->execute, &cpu->memory, &cpu->writeback};
+
+    print_stage_content(cpu, apex_stage_names[stage], latches[stage]);
+}
+
+/* Prints the register file, data memory (or, with mem_delta_view, the
+ * words stored to since the previous call) and flags after every cycle */
+void
+APEX_cpu_print_state(APEX_CPU *cpu)
+{
+    print_reg_file(cpu);
+    if (cpu->mem_delta_view)
+    {
+        print_memory_delta(cpu);
+    }
+    else
+    {
+        print_data_memory(cpu);
+    }
+    print_flag_values(cpu);
+    clear_memory_delta(cpu);
+}
+
+/* Records a value forwarded into decode from the EX/MEM latch */
+static int
+forward_from_ex(APEX_CPU *cpu, int reg, int value)
+{
+    cpu->bypass.ex_forwarded = TRUE;
+    cpu->bypass.ex_tag_forwarded = reg;
+    cpu->bypass.ex_value_forwarded = value;
+    cpu->regs_state[reg] = 0;
+    return value;
+}
+
+/* Records a value forwarded into decode from the MEM/WB latch */
+static int
+forward_from_mem(APEX_CPU *cpu, int reg, int value)
+{
+    cpu->bypass.mem_forwarded = TRUE;
+    cpu->bypass.mem_tag_forwarded = reg;
+    cpu->bypass.mem_value_forwarded = value;
+    cpu->regs_state[reg] = 0;
+    return value;
+}
+
+void FORWARDED_DECODER_MUX_RS1(APEX_CPU *cpu)
+{
+        const int rs1 = cpu->decode.insn->rs1;
+
+        if(cpu->memory.has_insn)
+        {   
+            //don't get rd from EX if instruction is LOADP/LAOD -- LOADP only resolves rd in MEM stage
+            if((cpu->memory.insn->opcode!=OPCODE_LOADP && cpu->memory.insn->opcode!=OPCODE_LOAD) && rs1 == cpu->memory.insn->rd)
+            {
+                cpu->decode.rs1_value = forward_from_ex(cpu, rs1, cpu->execute.result_buffer);
+                return;
+            }
+            else if(cpu->memory.insn->opcode==OPCODE_STOREP && rs1 == cpu->memory.insn->rs2)
+            {
+                cpu->decode.rs1_value = forward_from_ex(cpu, rs1, cpu->memory.rs2_value);
+                return;
+            }
+            else if(cpu->memory.insn->opcode==OPCODE_LOADP && rs1 == cpu->memory.insn->rs1)
+            {
+                cpu->decode.rs1_value = forward_from_ex(cpu, rs1, cpu->memory.rs1_value);
+                return;
+            }
+        }
+        if(cpu->writeback.has_insn)
+         {
+            if(rs1 == cpu->writeback.insn->rd)
+            {
+                cpu->decode.rs1_value = forward_from_mem(cpu, rs1, cpu->writeback.result_buffer);
+                return;
+            }
+            else if(cpu->writeback.insn->opcode==OPCODE_STOREP && rs1 == cpu->writeback.insn->rs2)
+            {
+                cpu->decode.rs1_value = forward_from_mem(cpu, rs1, cpu->writeback.rs2_value);
+                return;
+            }
+            else if(cpu->writeback.insn->opcode==OPCODE_LOADP && rs1 == cpu->writeback.insn->rs1)
+            {
+                cpu->decode.rs1_value = forward_from_mem(cpu, rs1, cpu->writeback.rs1_value);
+                return; 
+            }
+         }
+
+            cpu->decode.rs1_value = cpu->regs[rs1];
+}
+
+void FORWARDED_DECODER_MUX_RS2(APEX_CPU *cpu)
+{
+       const int rs2 = cpu->decode.insn->rs2;
+
+       if(cpu->memory.has_insn)
+        {
+            //don't get rd from EX if instruction is LOADP/LAOD -- LOADP only resolves rd in MEM stage
+            if((cpu->memory.insn->opcode!=OPCODE_LOADP && cpu->memory.insn->opcode!=OPCODE_LOAD) && rs2 == cpu->memory.insn->rd)            
+            {
+                cpu->decode.rs2_value = forward_from_ex(cpu, rs2, cpu->memory.result_buffer);
+                return;
+            }
+            else if(cpu->memory.insn->opcode==OPCODE_STOREP && rs2 == cpu->memory.insn->rs2)
+            {
+                cpu->decode.rs2_value = forward_from_ex(cpu, rs2, cpu->memory.rs2_value);
+                return;
+            }
+            else if(cpu->memory.insn->opcode==OPCODE_LOADP && rs2 == cpu->memory.insn->rs1)
+            {
+                cpu->decode.rs2_value = forward_from_ex(cpu, rs2, cpu->memory.rs1_value);
+                return;
+            }
+        }
+        if(cpu->writeback.has_insn)
+        {
+            if(rs2 == cpu->writeback.insn->rd)
+            {
+                cpu->decode.rs2_value = forward_from_mem(cpu, rs2, cpu->writeback.result_buffer);
+                return;
+            }
+            else if(cpu->writeback.insn->opcode==OPCODE_STOREP && rs2 == cpu->writeback.insn->rs2)
+            {
+                cpu->decode.rs2_value = forward_from_mem(cpu, rs2, cpu->writeback.rs2_value);
+                return;
+            }
+            else if(cpu->writeback.insn->opcode==OPCODE_LOADP && rs2 == cpu->writeback.insn->rs1)
+            {
+                cpu->decode.rs2_value = forward_from_mem(cpu, rs2, cpu->writeback.rs1_value);
+                return;
+            }
+        }
+
+        cpu->decode.rs2_value = cpu->regs[rs2];
+
+}
+
+
+/*
+ * Fetch Stage of APEX Pipeline
+ *
+ * Note: You are free to edit this function according to your implementation
+ */
+static void
+APEX_fetch(APEX_CPU *cpu)
+{
+    if ((cpu->fetch.has_insn))
+    {
+        if (cpu->stall_pipeline == 1)
+        {
+            cpu->fetch_before_stall = 0; // stall fetches from the next cycle.
+        }
+        /* This fetches new branch target instruction from next cycle */
+        if (cpu->fetch_from_next_cycle == TRUE)
+        {
+            cpu->fetch_from_next_cycle = FALSE;
+            cpu->counters.bubbles[STAGE_FETCH]++;
+
+            /* Skip this cycle*/
+            return;
+        }
+
+        /* Store current PC in fetch latch */
+        cpu->fetch.pc = cpu->pc;
+
+        /* Index into code memory using this pc; the latch only keeps a
+         * reference to the pre-decoded instruction */
+        cpu->fetch.insn = &cpu->code_memory[get_code_memory_index_from_pc(cpu->pc)];
+
+        if (cpu->stall_pipeline == 0)
+        {
+            /* Update PC for next instruction */
+            cpu->pc += 4;
+
+            /* Copy data from fetch latch to decode latch*/
+            copy_latch(cpu, &cpu->decode, &cpu->fetch);
+        }
+
+        /* Stop fetching new instructions if HALT is fetched */
+        if (cpu->fetch.insn->opcode == OPCODE_HALT && cpu->stall_pipeline == 0)
+        {
+            cpu->fetch.has_insn = FALSE;
+        }
+    }
+    else
+    {
+        cpu->counters.bubbles[STAGE_FETCH]++;
+    }
+}
+
+/* Returns TRUE when none of the registers in src_mask is waiting on a
+ * pending write in the scoreboard */
+static int
+source_registers_ready(const APEX_CPU *cpu, unsigned int src_mask)
+{
+    while (src_mask)
+    {
+        if (cpu->regs_state[__builtin_ctz(src_mask)])
+        {
+            return FALSE;
+        }
+        src_mask &= src_mask - 1;
+    }
+
+    return TRUE;
+}
+
+/* Marks every register in dst_mask as pending until writeback */
+static void
+claim_destination_registers(APEX_CPU *cpu, unsigned int dst_mask)
+{
+    while (dst_mask)
+    {
+        cpu->regs_state[__builtin_ctz(dst_mask)] = 1;
+        dst_mask &= dst_mask - 1;
+    }
+}
+
+/* Marks every register in dst_mask as written back */
+static void
+release_destination_registers(APEX_CPU *cpu, unsigned int dst_mask)
+{
+    while (dst_mask)
+    {
+        cpu->regs_state[__builtin_ctz(dst_mask)] = 0;
+        dst_mask &= dst_mask - 1;
+    }
+}
+
+/*
+ * Hazard policies. Each reads the source operands of the instruction in
+ * decode into its latch and returns TRUE once all of them are available:
+ *
+ *   stalling    scoreboard only, sources are read from the register file
+ *               once their producer has written back
+ *   forwarding  results are forwarded into decode from the EX/MEM and
+ *               MEM/WB latches, see FORWARDED_DECODER_MUX_RS1/RS2
+ *   bypass      every source is taken from the youngest instruction past
+ *               execute that writes it, only a load still in the memory
+ *               stage holds its consumer back
+ *
+ * The decode stage and cycle function of each policy are generated by
+ * DEFINE_HAZARD_POLICY, so a simulated cycle never tests which one is used.
+ */
+static int
+read_operands_stalling(APEX_CPU *cpu)
+{
+    const APEX_Instruction *insn = cpu->decode.insn;
+
+    if (!source_registers_ready(cpu, insn->src_mask))
+    {
+        return FALSE;
+    }
+
+    if (insn->info->src & ROLE_RS1)
+    {
+        cpu->decode.rs1_value = cpu->regs[insn->rs1];
+    }
+    if (insn->info->src & ROLE_RS2)
+    {
+        cpu->decode.rs2_value = cpu->regs[insn->rs2];
+    }
+    return TRUE;
+}
+
+static int
+read_operands_forwarding(APEX_CPU *cpu)
+{
+    const APEX_Instruction *insn = cpu->decode.insn;
+
+    cpu->bypass.ex_forwarded = FALSE;
+    cpu->bypass.mem_forwarded = FALSE;
+
+    if (insn->info->src & ROLE_RS1)
+    {
+        FORWARDED_DECODER_MUX_RS1(cpu);
+    }
+    if (insn->info->src & ROLE_RS2)
+    {
+        FORWARDED_DECODER_MUX_RS2(cpu);
+    }
+    return source_registers_ready(cpu, insn->src_mask);
+}
+
+/* Value of reg as written back by the instruction in stage. Returns FALSE
+ * if it is the rd of a load that has not read data memory yet */
+static int
+latch_value(const CPU_Stage *stage, int reg, int loaded, int *value)
+{
+    const APEX_Instruction *insn = stage->insn;
+
+    /* Reverse of the writeback order, the last write wins */
+    if ((insn->info->dst & ROLE_RS2) && insn->rs2 == reg)
+    {
+        *value = stage->rs2_value;
+    }
+    else if ((insn->info->dst & ROLE_RS1) && insn->rs1 == reg)
+    {
+        *value = stage->rs1_value;
+    }
+    else if (insn->info->memory == MEM_LOAD && !loaded)
+    {
+        return FALSE;
+    }
+    else
+    {
+        *value = stage->result_buffer;
+    }
+    return TRUE;
+}
+
+/* Reads reg from the youngest latch writing it, recording the value in
+ * cpu->bypass like a forwarding path. Returns FALSE if it is not loaded yet */
+static int
+bypass_read(APEX_CPU *cpu, int reg, int *value)
+{
+    const unsigned int bit = 1u << reg;
+
+    /* The instruction in memory is younger than the one in writeback */
+    if (cpu->memory.has_insn && (cpu->memory.insn->dst_mask & bit))
+    {
+        if (!latch_value(&cpu->memory, reg, FALSE, value))
+        {
+            return FALSE;
+        }
+        cpu->bypass.ex_forwarded = TRUE;
+        cpu->bypass.ex_tag_forwarded = reg;
+        cpu->bypass.ex_value_forwarded = *value;
+        return TRUE;
+    }
+    if (cpu->writeback.has_insn && (cpu->writeback.insn->dst_mask & bit))
+    {
+        latch_value(&cpu->writeback, reg, TRUE, value);
+        cpu->bypass.mem_forwarded = TRUE;
+        cpu->bypass.mem_tag_forwarded = reg;
+        cpu->bypass.mem_value_forwarded = *value;
+        return TRUE;
+    }
+
+    *value = cpu->regs[reg];
+    return TRUE;
+}
+
+static int
+read_operands_bypass(APEX_CPU *cpu)
+{
+    const APEX_Instruction *insn = cpu->decode.insn;
+    int ready = TRUE;
+
+    cpu->bypass.ex_forwarded = FALSE;
+    cpu->bypass.mem_forwarded = FALSE;
+
+    if (insn->info->src & ROLE_RS1)
+    {
+        ready &= bypass_read(cpu, insn->rs1, &cpu->decode.rs1_value);
+    }
+    if (insn->info->src & ROLE_RS2)
+    {
+        ready &= bypass_read(cpu, insn->rs2, &cpu->decode.rs2_value);
+    }
+    return ready;
+}
+
+/* STALL_CAUSE_* of a cycle the instruction in decode is held back, ready
+ * telling whether its sources were available. Sets producer to the latch
+ * of the instruction it waits on, NULL if none is in flight */
+static int
+stall_cause(const APEX_CPU *cpu, int ready, const CPU_Stage **producer)
+{
+    const APEX_Instruction *insn = cpu->decode.insn;
+
+    if (ready)
+    {
+        *producer = &cpu->execute;
+        return ((insn->info->flags & FLAGS_READ)
+                && (cpu->execute.insn->info->flags & FLAGS_WRITE))
+                   ? STALL_CAUSE_FLAGS
+                   : STALL_CAUSE_EXECUTE_BUSY;
+    }
+
+    /* The youngest instruction in flight writing a source holds it back */
+    *producer = NULL;
+    if (cpu->execute.has_insn && (cpu->execute.insn->dst_mask & insn->src_mask))
+    {
+        *producer = &cpu->execute;
+    }
+    else if (cpu->memory.has_insn && (cpu->memory.insn->dst_mask & insn->src_mask))
+    {
+        *producer = &cpu->memory;
+    }
+    else if (cpu->writeback.has_insn && (cpu->writeback.insn->dst_mask & insn->src_mask))
+    {
+        *producer = &cpu->writeback;
+    }
+    return (*producer && (*producer)->insn->info->memory == MEM_LOAD) ? STALL_CAUSE_LOAD_USE
+                                                                       : STALL_CAUSE_RAW;
+}
+
+/* Profile entry of the instruction in a latch, see apex_profile.c */
+static APEX_Profile_Entry *
+profile_entry(const APEX_CPU *cpu, const CPU_Stage *latch)
+{
+    return &cpu->profile[latch->insn - cpu->code_memory];
+}
+
+/* Profile entry of the instruction fetch reads at pc; past the end of the
+ * program, the CPU fetches the sentinel entry */
+static APEX_Profile_Entry *
+profile_fetch_entry(const APEX_CPU *cpu)
+{
+    int index = get_code_memory_index_from_pc(cpu->pc);
+
+    if (cpu->pc < 4000 || index > cpu->code_memory_size)
+    {
+        index = cpu->code_memory_size;
+    }
+    return &cpu->profile[index];
+}
+
+/*
+ * Counts one cycle of every instruction in the pipeline to the profile,
+ * before the cycle runs: the latches then hold what each stage works on
+ * in it, and fetch works on the instruction at pc
+ */
+static void
+profile_cycle(APEX_CPU *cpu)
+{
+    /* Fetch does nothing in the cycle a taken branch redirects it */
+    if (cpu->fetch.has_insn && !cpu->fetch_from_next_cycle)
+    {
+        profile_fetch_entry(cpu)->stage_cycles[STAGE_FETCH]++;
+    }
+    if (cpu->decode.has_insn)
+    {
+        profile_entry(cpu, &cpu->decode)->stage_cycles[STAGE_DECODE]++;
+    }
+    if (cpu->execute.has_insn)
+    {
+        profile_entry(cpu, &cpu->execute)->stage_cycles[STAGE_EXECUTE]++;
+    }
+    if (cpu->memory.has_insn)
+    {
+        profile_entry(cpu, &cpu->memory)->stage_cycles[STAGE_MEMORY]++;
+    }
+    if (cpu->writeback.has_insn)
+    {
+        profile_entry(cpu, &cpu->writeback)->stage_cycles[STAGE_WRITEBACK]++;
+    }
+}
+
+/* Moves the decoded instruction to execute once its sources are available
+ * (ready) and the functional unit is free, otherwise holds it in decode and
+ * stalls the front end */
+static void
+issue_when_ready(APEX_CPU *cpu, int ready)
+{
+    const APEX_Instruction *insn = cpu->decode.insn;
+
+    if (!cpu->execute.has_insn && ready)
+    {
+        claim_destination_registers(cpu, insn->dst_mask);
+        copy_latch(cpu, &cpu->execute, &cpu->decode);
+        cpu->execute.cycles_left = cpu->latency[insn->opcode];
+        cpu->decode.has_insn = FALSE;
+        cpu->stall_pipeline = 0;
+        cpu->counters.forward_memory += cpu->bypass.ex_forwarded;
+        cpu->counters.forward_writeback += cpu->bypass.mem_forwarded;
+    }
+    else
+    {
+        cpu->stall_pipeline = 1;
+        cpu->stall_cycles++;
+        cpu->stall_reason = (cpu->execute.has_insn ? STALL_EXECUTE_BUSY : STALL_NONE)
+                            | (ready ? STALL_NONE : STALL_OPERANDS);
+        cpu->stall_cause = stall_cause(cpu, ready, &cpu->stall_producer);
+        cpu->counters.stalls[cpu->stall_cause]++;
+    }
+}
+
+/* Counts the cycle the instruction in decode was just held back to its
+ * profile entry, and to the entry of the instruction it waited on */
+static void
+profile_stall(APEX_CPU *cpu)
+{
+    profile_entry(cpu, &cpu->decode)->stalls[cpu->stall_cause]++;
+    if (cpu->stall_producer)
+    {
+        profile_entry(cpu, cpu->stall_producer)->caused++;
+    }
+}
+
+/* Sets the P, Z and N flags from an ALU or compare result */
+static void
+set_flags_from_result(APEX_CPU *cpu, int result)
+{
+    cpu->zero_flag = (result == 0) ? TRUE : FALSE;
+    cpu->positive_flag = (result > 0) ? TRUE : FALSE;
+    cpu->negative_flag = (result < 0) ? TRUE : FALSE;
+}
+
+/* Redirects fetch to target and flushes the younger instruction in decode */
+static void
+take_branch(APEX_CPU *cpu, int target)
+{
+    /* Calculate new PC, and send it to fetch unit */
+    cpu->pc = target;
+
+    /* Since we are using reverse callbacks for pipeline stages,
+     * this will prevent the new instruction from being fetched in the current cycle*/
+    cpu->fetch_from_next_cycle = TRUE;
+
+    /* Flush previous stages */
+    cpu->counters.branch_flushes++;
+    cpu->counters.squashed_fetches += cpu->decode.has_insn;
+    cpu->decode.has_insn = FALSE;
+
+    /* Make sure fetch stage is enabled to start fetching from new PC */
+    cpu->fetch.has_insn = TRUE;
+}
+
+/*
+ * Execute stage handlers, one per opcode and referenced from apex_opcodes.
+ * Each returns the value the P/Z/N flags are set from when the opcode has
+ * FLAGS_WRITE, and 0 otherwise
+ */
+static int
+execute_add(APEX_CPU *cpu)
+{
+    return cpu->execute.result_buffer = cpu->execute.rs1_value + cpu->execute.rs2_value;
+}
+
+static int
+execute_addl(APEX_CPU *cpu)
+{
+    return cpu->execute.result_buffer = cpu->execute.rs1_value + cpu->execute.insn->imm;
+}
+
+static int
+execute_sub(APEX_CPU *cpu)
+{
+    return cpu->execute.result_buffer = cpu->execute.rs1_value - cpu->execute.rs2_value;
+}
+
+static int
+execute_subl(APEX_CPU *cpu)
+{
+    return cpu->execute.result_buffer = cpu->execute.rs1_value - cpu->execute.insn->imm;
+}
+
+static int
+execute_mul(APEX_CPU *cpu)
+{
+    return cpu->execute.result_buffer = cpu->execute.rs1_value * cpu->execute.rs2_value;
+}
+
+static int
+execute_div(APEX_CPU *cpu)
+{
+    /* Division by zero (and the one overflowing case) yields 0 */
+    if (cpu->execute.rs2_value == 0
+        || (cpu->execute.rs1_value == INT_MIN && cpu->execute.rs2_value == -1))
+    {
+        return cpu->execute.result_buffer = 0;
+    }
+
+    return cpu->execute.result_buffer = cpu->execute.rs1_value / cpu->execute.rs2_value;
+}
+
+static int
+execute_and(APEX_CPU *cpu)
+{
+    return cpu->execute.result_buffer = cpu->execute.rs1_value & cpu->execute.rs2_value;
+}
+
+static int
+execute_or(APEX_CPU *cpu)
+{
+    return cpu->execute.result_buffer = cpu->execute.rs1_value | cpu->execute.rs2_value;
+}
+
+static int
+execute_xor(APEX_CPU *cpu)
+{
+    return cpu->execute.result_buffer = cpu->execute.rs1_value ^ cpu->execute.rs2_value;
+}
+
+static int
+execute_cmp(APEX_CPU *cpu)
+{
+    return cpu->execute.rs1_value - cpu->execute.rs2_value;
+}
+
+static int
+execute_cml(APEX_CPU *cpu)
+{
+    return cpu->execute.rs1_value - cpu->execute.insn->imm;
+}
+
+static int
+execute_movc(APEX_CPU *cpu)
+{
+    cpu->execute.result_buffer = cpu->execute.insn->imm;
+    return 0;
+}
+
+static int
+execute_load(APEX_CPU *cpu)
+{
+    cpu->execute.memory_address = cpu->execute.rs1_value + cpu->execute.insn->imm;
+    return 0;
+}
+
+static int
+execute_store(APEX_CPU *cpu)
+{
+    cpu->execute.memory_address = cpu->execute.rs2_value + cpu->execute.insn->imm;
+    return 0;
+}
+
+static int
+execute_loadp(APEX_CPU *cpu)
+{
+    cpu->execute.memory_address = cpu->execute.rs1_value + cpu->execute.insn->imm;
+    cpu->execute.rs1_value = cpu->execute.rs1_value + 4;
+    return 0;
+}
+
+static int
+execute_storep(APEX_CPU *cpu)
+{
+    cpu->execute.memory_address = cpu->execute.rs2_value + cpu->execute.insn->imm;
+    cpu->execute.rs2_value = cpu->execute.rs2_value + 4;
+    return 0;
+}
+
+static int
+execute_bz(APEX_CPU *cpu)
+{
+    if (cpu->zero_flag == TRUE)
+    {
+        take_branch(cpu, cpu->execute.pc + cpu->execute.insn->imm);
+    }
+    return 0;
+}
+
+static int
+execute_bnz(APEX_CPU *cpu)
+{
+    if (cpu->zero_flag == FALSE)
+    {
+        take_branch(cpu, cpu->execute.pc + cpu->execute.insn->imm);
+    }
+    return 0;
+}
+
+static int
+execute_bp(APEX_CPU *cpu)
+{
+    if (cpu->positive_flag == TRUE)
+    {
+        take_branch(cpu, cpu->execute.pc + cpu->execute.insn->imm);
+    }
+    return 0;
+}
+
+static int
+execute_bnp(APEX_CPU *cpu)
+{
+    if (cpu->positive_flag == FALSE)
+    {
+        take_branch(cpu, cpu->execute.pc + cpu->execute.insn->imm);
+    }
+    return 0;
+}
+
+static int
+execute_bn(APEX_CPU *cpu)
+{
+    if (cpu->negative_flag == TRUE)
+    {
+        take_branch(cpu, cpu->execute.pc + cpu->execute.insn->imm);
+    }
+    return 0;
+}
+
+static int
+execute_bnn(APEX_CPU *cpu)
+{
+    if (cpu->negative_flag == FALSE)
+    {
+        take_branch(cpu, cpu->execute.pc + cpu->execute.insn->imm);
+    }
+    return 0;
+}
+
+static int
+execute_jump(APEX_CPU *cpu)
+{
+    take_branch(cpu, cpu->execute.rs1_value + cpu->execute.insn->imm);
+    return 0;
+}
+
+static int
+execute_jalr(APEX_CPU *cpu)
+{
+    cpu->execute.result_buffer = cpu->execute.pc + 4;
+    take_branch(cpu, cpu->execute.rs1_value + cpu->execute.insn->imm);
+    return 0;
+}
+
+static int
+execute_nop(APEX_CPU *cpu)
+{
+    /* No work in execute */
+    return 0;
+}
+
+/*
+ * Opcode descriptor table, indexed by OPCODE_* value. Every pipeline stage,
+ * the file parser and the debug printer work from this table, so a new
+ * instruction is added by giving it an OPCODE_* value, a mnemonic in
+ * file_parser.c and an entry here.
+ *
+ * NOP keeps its historical behaviour: it is dropped in decode and replaced
+ * by the next fetched instruction without retiring.
+ */
+#define RRR {OPERAND_RD, OPERAND_RS1, OPERAND_RS2}
+#define RRI {OPERAND_RD, OPERAND_RS1, OPERAND_IMM}
+
+static const APEX_Opcode_Info apex_opcodes[NUM_OPCODES] = {
+    /*                operands                                    src                   dst                  flags        memory     lat  execute */
+    [OPCODE_ADD]    = {RRR,                                       ROLE_RS1 | ROLE_RS2,  ROLE_RD,             FLAGS_WRITE, MEM_NONE,  1, execute_add},
+    [OPCODE_SUB]    = {RRR,                                       ROLE_RS1 | ROLE_RS2,  ROLE_RD,             FLAGS_WRITE, MEM_NONE,  1, execute_sub},
+    [OPCODE_MUL]    = {RRR,                                       ROLE_RS1 | ROLE_RS2,  ROLE_RD,             FLAGS_WRITE, MEM_NONE,  1, execute_mul},
+    [OPCODE_DIV]    = {RRR,                                       ROLE_RS1 | ROLE_RS2,  ROLE_RD,             FLAGS_WRITE, MEM_NONE,  1, execute_div},
+    [OPCODE_AND]    = {RRR,                                       ROLE_RS1 | ROLE_RS2,  ROLE_RD,             FLAGS_WRITE, MEM_NONE,  1, execute_and},
+    [OPCODE_OR]     = {RRR,                                       ROLE_RS1 | ROLE_RS2,  ROLE_RD,             FLAGS_WRITE, MEM_NONE,  1, execute_or},
+    [OPCODE_XOR]    = {RRR,                                       ROLE_RS1 | ROLE_RS2,  ROLE_RD,             FLAGS_WRITE, MEM_NONE,  1, execute_xor},
+    [OPCODE_ADDL]   = {RRI,                                       ROLE_RS1,             ROLE_RD,             FLAGS_WRITE, MEM_NONE,  1, execute_addl},
+    [OPCODE_SUBL]   = {RRI,                                       ROLE_RS1,             ROLE_RD,             FLAGS_WRITE, MEM_NONE,  1, execute_subl},
+    [OPCODE_MOVC]   = {{OPERAND_RD, OPERAND_IMM},                 0,                    ROLE_RD,             FLAGS_NONE,  MEM_NONE,  1, execute_movc},
+    [OPCODE_LOAD]   = {RRI,                                       ROLE_RS1,             ROLE_RD,             FLAGS_NONE,  MEM_LOAD,  1, execute_load},
+    [OPCODE_LOADP]  = {RRI,                                       ROLE_RS1,             ROLE_RD | ROLE_RS1,  FLAGS_NONE,  MEM_LOAD,  1, execute_loadp},
+    [OPCODE_STORE]  = {{OPERAND_RS1, OPERAND_RS2, OPERAND_IMM},   ROLE_RS1 | ROLE_RS2,  0,                   FLAGS_NONE,  MEM_STORE, 1, execute_store},
+    [OPCODE_STOREP] = {{OPERAND_RS1, OPERAND_RS2, OPERAND_IMM},   ROLE_RS1 | ROLE_RS2,  ROLE_RS2,            FLAGS_NONE,  MEM_STORE, 1, execute_storep},
+    [OPCODE_BZ]     = {{OPERAND_IMM},                             0,                    0,                   FLAGS_READ,  MEM_NONE,  1, execute_bz},
+    [OPCODE_BNZ]    = {{OPERAND_IMM},                             0,                    0,                   FLAGS_READ,  MEM_NONE,  1, execute_bnz},
+    [OPCODE_BP]     = {{OPERAND_IMM},                             0,                    0,                   FLAGS_READ,  MEM_NONE,  1, execute_bp},
+    [OPCODE_BNP]    = {{OPERAND_IMM},                             0,                    0,                   FLAGS_READ,  MEM_NONE,  1, execute_bnp},
+    [OPCODE_BN]     = {{OPERAND_IMM},                             0,                    0,                   FLAGS_READ,  MEM_NONE,  1, execute_bn},
+    [OPCODE_BNN]    = {{OPERAND_IMM},                             0,                    0,                   FLAGS_READ,  MEM_NONE,  1, execute_bnn},
+    [OPCODE_CMP]    = {{OPERAND_RS1, OPERAND_RS2},                ROLE_RS1 | ROLE_RS2,  0,                   FLAGS_WRITE, MEM_NONE,  1, execute_cmp},
+    [OPCODE_CML]    = {{OPERAND_RS1, OPERAND_IMM},                ROLE_RS1,             0,                   FLAGS_WRITE, MEM_NONE,  1, execute_cml},
+    [OPCODE_JUMP]   = {{OPERAND_RS1, OPERAND_IMM},                ROLE_RS1,             0,                   FLAGS_NONE,  MEM_NONE,  1, execute_jump},
+    [OPCODE_JALR]   = {RRI,                                       ROLE_RS1,             ROLE_RD,             FLAGS_NONE,  MEM_NONE,  1, execute_jalr},
+    [OPCODE_HALT]   = {{OPERAND_NONE},                            0,                    0,                   FLAGS_NONE,  MEM_NONE,  1, execute_nop},
+    [OPCODE_NOP]    = {{OPERAND_NONE},                            0,                    0,                   FLAGS_NONE,  MEM_NONE,  1, execute_nop, TRUE},
+};
+
+#undef RRR
+#undef RRI
+
+/*
+ * Returns the descriptor of an opcode, used by the file parser to attach it
+ * to every instruction in code memory
+ */
+const APEX_Opcode_Info *
+APEX_get_opcode_info(int opcode)
+{
+    if (opcode < 0 || opcode >= NUM_OPCODES || !apex_opcodes[opcode].execute)
+    {
+        return NULL;
+    }
+
+    return &apex_opcodes[opcode];
+}
+
+/*
+ * Execute Stage of APEX Pipeline
+ *
+ * Note: You are free to edit this function according to your implementation
+ */
+static void
+APEX_execute(APEX_CPU *cpu)
+{
+    if (cpu->execute.has_insn)
+    {
+        const APEX_Opcode_Info *info = cpu->execute.insn->info;
+
+        /* Execute logic runs on the first cycle in the functional unit, the
+         * instruction then occupies it for the opcode's latency */
+        if (cpu->execute.cycles_left == cpu->latency[cpu->execute.insn->opcode])
+        {
+            int result = info->execute(cpu);
+
+            if (info->flags & FLAGS_WRITE)
+            {
+                set_flags_from_result(cpu, result);
+            }
+        }
+        cpu->execute.cycles_left--;
+
+        if (cpu->execute.cycles_left == 0)
+        {
+            /* Copy data from execute latch to memory latch*/
+            copy_latch(cpu, &cpu->memory, &cpu->execute);
+            cpu->execute.has_insn = FALSE;
+        }
+    }
+    else
+    {
+        cpu->counters.bubbles[STAGE_EXECUTE]++;
+    }
+}
+
+/*
+ * Memory Stage of APEX Pipeline
+ *
+ * Note: You are free to edit this function according to your implementation
+ */
+static void
+APEX_memory(APEX_CPU *cpu)
+{
+    if (cpu->memory.has_insn)
+    {
+        switch (cpu->memory.insn->info->memory)
+        {
+        case MEM_LOAD:
+        {
+            /* Read from data memory */
+            cpu->memory.result_buffer = cpu->data_memory[cpu->memory.memory_address];
+            break;
+        }
+
+        case MEM_STORE:
+        {
+            APEX_cpu_store(cpu, cpu->memory.memory_address, cpu->memory.rs1_value);
+            break;
+        }
+        }
+
+        /* Copy data from memory latch to writeback latch*/
+        copy_latch(cpu, &cpu->writeback, &cpu->memory);
+        cpu->memory.has_insn = FALSE;
+    }
+    else
+    {
+        cpu->counters.bubbles[STAGE_MEMORY]++;
+    }
+}
+
+/* Records the registers written back by insn, with their new values */
+static void
+trace_register_writes(APEX_CPU *cpu, const APEX_Instruction *insn)
+{
+    unsigned int dst_mask = insn->dst_mask;
+    int reg;
+
+    while (dst_mask)
+    {
+        reg = __builtin_ctz(dst_mask);
+        APEX_trace_value(cpu->trace, TRACE_REG, cpu->clock, reg, cpu->regs[reg]);
+        dst_mask &= dst_mask - 1;
+    }
+}
+
+/*
+ * Writeback Stage of APEX Pipeline
+ *
+ * Note: You are free to edit this function according to your implementation
+ */
+static int
+APEX_writeback(APEX_CPU *cpu)
+{
+    if (cpu->writeback.has_insn)
+    {
+        const APEX_Instruction *insn = cpu->writeback.insn;
+
+        /* Write results to register file based on the destination roles */
+        if (insn->info->dst & ROLE_RD)
+        {
+            cpu->regs[insn->rd] = cpu->writeback.result_buffer;
+        }
+        if (insn->info->dst & ROLE_RS1)
+        {
+            /* LOADP post-incremented base */
+            cpu->regs[insn->rs1] = cpu->writeback.rs1_value;
+        }
+        if (insn->info->dst & ROLE_RS2)
+        {
+            /* STOREP post-incremented base */
+            cpu->regs[insn->rs2] = cpu->writeback.rs2_value;
+        }
+        release_destination_registers(cpu, insn->dst_mask);
+
+        cpu->insn_completed++;
+        cpu->counters.retired[insn->opcode]++;
+        cpu->writeback.has_insn = FALSE;
+
+        if (insn->opcode == OPCODE_HALT)
+        {
+            /* Stop the APEX simulator */
+            return TRUE;
+        }
+    }
+    else
+    {
+        cpu->counters.bubbles[STAGE_WRITEBACK]++;
+    }
+
+    /* Default */
+    return 0;
+}
+
+/* TRACE_FLAG_* bits of the flags of cpu */
+static int
+flag_bits(const APEX_CPU *cpu)
+{
+    return (cpu->zero_flag ? TRACE_FLAG_ZERO : 0) | (cpu->positive_flag ? TRACE_FLAG_POSITIVE : 0)
+           | (cpu->negative_flag ? TRACE_FLAG_NEGATIVE : 0);
+}
+
+/*
+ * Runs one cycle as simulate_cycle_<policy> does with the given decode
+ * stage, and reports every stage that held an instruction, in the order
+ * the stages run, and the state it changed to the trace. The stages do not
+ * report themselves, so cycles run through simulate_cycle_<policy> pay
+ * nothing for the output. Returns TRUE when HALT retires
+ */
+static int
+observe_cycle(APEX_CPU *cpu, void (*decode)(APEX_CPU *cpu))
+{
+    int flags = flag_bits(cpu);
+    int stalls = cpu->stall_cycles;
+    int active, halted;
+
+    if (cpu->profile)
+    {
+        profile_cycle(cpu);
+    }
+
+    active = cpu->writeback.has_insn;
+    halted = APEX_writeback(cpu);
+    if (active)
+    {
+        if (cpu->trace)
+        {
+            trace_register_writes(cpu, cpu->writeback.insn);
+        }
+        report_stage(cpu, STAGE_WRITEBACK, &cpu->writeback);
+    }
+    if (halted)
+    {
+        return TRUE;
+    }
+
+    active = cpu->memory.has_insn;
+    APEX_memory(cpu);
+    if (active)
+    {
+        if (cpu->trace && cpu->memory.insn->info->memory == MEM_STORE)
+        {
+            APEX_trace_value(cpu->trace, TRACE_MEM, cpu->clock, cpu->memory.memory_address,
+                             cpu->memory.rs1_value);
+        }
+        report_stage(cpu, STAGE_MEMORY, &cpu->memory);
+    }
+
+    active = cpu->execute.has_insn;
+    APEX_execute(cpu);
+    if (active)
+    {
+        report_stage(cpu, STAGE_EXECUTE, &cpu->execute);
+    }
+    if (cpu->trace && flag_bits(cpu) != flags)
+    {
+        APEX_trace_value(cpu->trace, TRACE_FLAGS, cpu->clock, 0, flag_bits(cpu));
+    }
+
+    active = cpu->decode.has_insn;
+    decode(cpu);
+    if (cpu->profile && cpu->stall_cycles != stalls)
+    {
+        profile_stall(cpu);
+    }
+    if (active)
+    {
+        report_stage(cpu, STAGE_DECODE, &cpu->decode);
+    }
+
+    /* Fetch does nothing in the cycle a taken branch redirects it */
+    active = cpu->fetch.has_insn && !cpu->fetch_from_next_cycle;
+    APEX_fetch(cpu);
+    if (active)
+    {
+        report_stage(cpu, STAGE_FETCH, &cpu->fetch);
+    }
+    return FALSE;
+}
+
+/*
+ * Decode Stage of APEX Pipeline, and the cycle functions running every
+ * stage once, for the hazard policy whose read_operands_<policy> resolves
+ * the sources: simulate_cycle_<policy> without any output,
+ * profile_cycle_<policy> counting the cycle to the profile as well, and
+ * observe_cycle_<policy> reporting the stages, see observe_cycle. All
+ * return TRUE when HALT retires
+ *
+ * Note: You are free to edit this function according to your implementation
+ */
+#define DEFINE_HAZARD_POLICY(policy)                                          \
+    static void                                                               \
+    APEX_decode_##policy(APEX_CPU *cpu)                                       \
+    {                                                                         \
+        if (cpu->decode.has_insn)                                             \
+        {                                                                     \
+            if (!cpu->decode.insn->info->dropped_in_decode)                   \
+            {                                                                 \
+                issue_when_ready(cpu, read_operands_##policy(cpu));           \
+            }                                                                 \
+        }                                                                     \
+        else                                                                  \
+        {                                                                     \
+            cpu->counters.bubbles[STAGE_DECODE]++;                            \
+        }                                                                     \
+    }                                                                         \
+                                                                              \
+    static int                                                                \
+    simulate_cycle_##policy(APEX_CPU *cpu)                                    \
+    {                                                                         \
+        if (APEX_writeback(cpu))                                              \
+        {                                                                     \
+            return TRUE;                                                      \
+        }                                                                     \
+                                                                              \
+        APEX_memory(cpu);                                                     \
+        APEX_execute(cpu);                                                    \
+        APEX_decode_##policy(cpu);                                            \
+        APEX_fetch(cpu);                                                      \
+        return FALSE;                                                         \
+    }                                                                         \
+                                                                              \
+    static int                                                                \
+    profile_cycle_##policy(APEX_CPU *cpu)                                     \
+    {                                                                         \
+        int stalls = cpu->stall_cycles;                                       \
+                                                                              \
+        profile_cycle(cpu);                                                   \
+        if (APEX_writeback(cpu))                                              \
+        {                                                                     \
+            return TRUE;                                                      \
+        }                                                                     \
+                                                                              \
+        APEX_memory(cpu);                                                     \
+        APEX_execute(cpu);                                                    \
+        APEX_decode_##policy(cpu);                                            \
+        if (cpu->stall_cycles != stalls)                                      \
+        {                                                                     \
+            profile_stall(cpu);                                               \
+        }                                                                     \
+        APEX_fetch(cpu);                                                      \
+        return FALSE;                                                         \
+    }                                                                         \
+                                                                              \
+    static int                                                                \
+    observe_cycle_##policy(APEX_CPU *cpu)                                     \
+    {                                                                         \
+        return observe_cycle(cpu, APEX_decode_##policy);                      \
+    }
+
+DEFINE_HAZARD_POLICY(stalling)
+DEFINE_HAZARD_POLICY(forwarding)
+DEFINE_HAZARD_POLICY(bypass)
+
+#undef DEFINE_HAZARD_POLICY
+
+/* Hazard policies by HAZARD_* value */
+static const struct
+{
+    const char *name;
+    int (*simulate_cycle)(APEX_CPU *cpu);
+    int (*profile_cycle)(APEX_CPU *cpu);
+    int (*observe_cycle)(APEX_CPU *cpu);
+} apex_hazard_policies[NUM_HAZARD_POLICIES] = {
+    [HAZARD_STALLING] = {"stalling", simulate_cycle_stalling, profile_cycle_stalling,
+                         observe_cycle_stalling},
+    [HAZARD_FORWARDING] = {"forwarding", simulate_cycle_forwarding, profile_cycle_forwarding,
+                           observe_cycle_forwarding},
+    [HAZARD_BYPASS] = {"bypass", simulate_cycle_bypass, profile_cycle_bypass,
+                       observe_cycle_bypass},
+};
+
+/* Name of a HAZARD_* policy, as accepted by APEX_hazard_from_string */
+const char *
+APEX_hazard_name(int policy)
+{
+    return apex_hazard_policies[policy].name;
+}
+
+/* HAZARD_* value of a policy name, -1 if there is none */
+int
+APEX_hazard_from_string(const char *name)
+{
+    int i;
+
+    for (i = 0; i < NUM_HAZARD_POLICIES; ++i)
+    {
+        if (strcmp(name, apex_hazard_policies[i].name) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* Selects the hazard policy the pipeline of cpu runs with from the next
+ * cycle, and its profiling cycle function if cpu is profiled */
+void
+APEX_cpu_set_hazard(APEX_CPU *cpu, int policy)
+{
+    cpu->hazard = policy;
+    cpu->simulate_cycle = cpu->profile ? apex_hazard_policies[policy].profile_cycle
+                                       : apex_hazard_policies[policy].simulate_cycle;
+    cpu->observe_cycle = apex_hazard_policies[policy].observe_cycle;
+}
+
+/*
+ * This function creates and initializes APEX cpu.
+ *
+ * Note: You are free to edit this function according to your implementation
+ */
+APEX_CPU *
+APEX_cpu_init(const char *filename)
+{
+    return APEX_cpu_create(filename, 0, stdout);
+}
+
+/*
+ * Creates a CPU running the given program section of filename (see
+ * get_code_sections) whose simulation output goes to out. With out NULL the
+ * CPU is silent: no code memory listing and no per-cycle output, as used by the
+ * batch runner. The listing is printed by APEX_cpu_print_code_memory
+ */
+APEX_CPU *
+APEX_cpu_create(const char *filename, int section, FILE *out)
+{
+    int i;
+    int data_count;
+    APEX_Binary_Data *data = NULL;
+    APEX_CPU *cpu;
+
+    if (!filename)
+    {
+        return NULL;
+    }
+
+    cpu = calloc(1, sizeof(APEX_CPU));
+
+    if (!cpu)
+    {
+        return NULL;
+    }
+
+    /* Initialize PC, Registers and all pipeline stages */
+    cpu->pc = 4000;
+    memset(cpu->regs, 0, sizeof(int) * REG_FILE_SIZE);
+    memset(cpu->data_memory, 0, sizeof(int) * DATA_MEMORY_SIZE);
+    cpu->out = out;
+    for (i = 0; i < NUM_OPCODES; ++i)
+    {
+        cpu->latency[i] = apex_opcodes[i].latency;
+    }
+    cpu->log_level = out ? DEFAULT_LOG_LEVEL : LOG_QUIET;
+    cpu->display_to = INT_MAX;
+    APEX_cpu_set_hazard(cpu, DEFAULT_HAZARD_POLICY);
+
+    /* Parse input file and create code memory */
+    cpu->filename = strdup(filename);
+    cpu->code_memory = create_code_memory(filename, section, &cpu->code_memory_size);
+    data_count = cpu->code_memory ? get_data_memory_init(filename, &data) : -1;
+    if (!cpu->filename || !cpu->code_memory || data_count < 0
+        || APEX_cpu_thread_code(cpu) != 0)
+    {
+        free(cpu->code_memory);
+        free(cpu->filename);
+        free(cpu);
+        return NULL;
+    }
+
+    /* Data memory a program image sets before it starts */
+    if (data_count > 0)
+    {
+        for (i = 0; i < data_count; ++i)
+        {
+            cpu->data_memory[data[i].addr] = data[i].value;
+        }
+        APEX_cpu_index_memory(cpu);
+    }
+    free(data);
+
+    if (ENABLE_LATCH_STATS)
+    {
+        fprintf(stderr,
+                "APEX_CPU: sizeof(CPU_Stage) = %zu, sizeof(APEX_Instruction) = %zu, "
+                "sizeof(APEX_CPU) = %zu\n",
+                sizeof(CPU_Stage), sizeof(APEX_Instruction), sizeof(APEX_CPU));
+    }
+
+    /* To start fetch stage */
+    cpu->fetch.has_insn = TRUE;
+    return cpu;
+}
+
+/*
+ * Prints the banner and the code memory listing, at LOG_PIPELINE only. Kept out
+ * of APEX_cpu_create so that the caller can set the log level first
+ */
+void
+APEX_cpu_print_code_memory(const APEX_CPU *cpu)
+{
+    int i;
+
+    if (cpu->log_level < LOG_PIPELINE)
+    {
+        return;
+    }
+
+    fprintf(stderr,
+            "APEX_CPU: Initialized APEX CPU, loaded %d instructions\n",
+            cpu->code_memory_size);
+    fprintf(stderr, "APEX_CPU: PC initialized to %d\n", cpu->pc);
+    fprintf(stderr, "APEX_CPU: Printing Code Memory\n");
+    fprintf(cpu->out, "%-9s %-9s %-9s %-9s %-9s\n", "opcode_str", "rd", "rs1", "rs2",
+           "imm");
+
+    for (i = 0; i < cpu->code_memory_size; ++i)
+    {
+        fprintf(cpu->out, "%-9s %-9d %-9d %-9d %-9d\n", cpu->code_memory[i].opcode_str,
+               cpu->code_memory[i].rd, cpu->code_memory[i].rs1,
+               cpu->code_memory[i].rs2, cpu->code_memory[i].imm);
+    }
+}
+
+/*
+ * Number of cycles from now in which no latch can make progress: execute is
+ * counting down a multi-cycle instruction with memory and writeback empty,
+ * and the front end is either empty or already stalled behind it. Those
+ * cycles only decrement execute.cycles_left, see skip_idle_cycles.
+ */
+static int
+idle_cycles(const APEX_CPU *cpu)
+{
+    if (!ENABLE_IDLE_SKIP || !cpu->execute.has_insn || cpu->memory.has_insn
+        || cpu->writeback.has_insn
+        || cpu->execute.cycles_left >= cpu->latency[cpu->execute.insn->opcode]
+        || cpu->fetch_from_next_cycle)
+    {
+        return 0;
+    }
+
+    if (cpu->decode.has_insn ? !cpu->stall_pipeline : cpu->fetch.has_insn)
+    {
+        return 0;
+    }
+
+    /* The last cycle in execute moves the instruction to memory */
+    return cpu->execute.cycles_left - 1;
+}
+
+/* Advances the clock over n idle cycles */
+static void
+skip_idle_cycles(APEX_CPU *cpu, int n)
+{
+    if (n == 0)
+    {
+        return;
+    }
+
+    cpu->clock += n;
+    cpu->execute.cycles_left -= n;
+
+    /* An instruction in decode would have stalled in each of them, for the
+     * same cause as in the cycle before; otherwise fetch is empty too */
+    if (cpu->decode.has_insn)
+    {
+        cpu->stall_cycles += n;
+        cpu->counters.stalls[cpu->stall_cause] += n;
+    }
+    else
+    {
+        cpu->counters.bubbles[STAGE_FETCH] += n;
+        cpu->counters.bubbles[STAGE_DECODE] += n;
+    }
+    cpu->counters.bubbles[STAGE_MEMORY] += n;
+    cpu->counters.bubbles[STAGE_WRITEBACK] += n;
+
+    /* With memory and writeback empty, the instruction in decode waits on
+     * the one in execute */
+    if (cpu->profile)
+    {
+        if (cpu->fetch.has_insn)
+        {
+            profile_fetch_entry(cpu)->stage_cycles[STAGE_FETCH] += n;
+        }
+        if (cpu->decode.has_insn)
+        {
+            profile_entry(cpu, &cpu->decode)->stage_cycles[STAGE_DECODE] += n;
+            profile_entry(cpu, &cpu->decode)->stalls[cpu->stall_cause] += n;
+            profile_entry(cpu, &cpu->execute)->caused += n;
+        }
+        profile_entry(cpu, &cpu->execute)->stage_cycles[STAGE_EXECUTE] += n;
+    }
+}
+
+/*
+ * Simulates one clock cycle without the per-cycle state dump, and skips
+ * any idle cycles after it whatever the clock reaches; a caller with a
+ * cycle limit uses APEX_cpu_step_until.
+ * Returns TRUE when HALT retires; that cycle is not counted, as in
+ * APEX_cpu_run
+ */
+int
+APEX_cpu_step(APEX_CPU *cpu)
+{
+    if (cpu->simulate_cycle(cpu))
+    {
+        return TRUE;
+    }
+
+    cpu->clock++;
+    skip_idle_cycles(cpu, idle_cycles(cpu));
+    return FALSE;
+}
+
+/*
+ * Simulates cycles until n more instructions retire.
+ * Returns TRUE if HALT retired first
+ */
+int
+APEX_cpu_step_insns(APEX_CPU *cpu, long n)
+{
+    long target = cpu->insn_completed + n;
+
+    while (cpu->insn_completed < target)
+    {
+        if (APEX_cpu_step(cpu))
+        {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/*
+ * Empties the pipeline so the architectural state can be handed to the
+ * functional model. Instructions in fetch and decode are squashed and the
+ * PC rewinds to the oldest of them; instructions already issued complete,
+ * including any branch still to resolve in execute.
+ *
+ * Returns TRUE if HALT retired while draining.
+ */
+int
+APEX_cpu_drain(APEX_CPU *cpu)
+{
+    int halted = FALSE;
+
+    if (cpu->decode.has_insn)
+    {
+        cpu->pc = cpu->decode.pc;
+    }
+    cpu->decode.has_insn = FALSE;
+    cpu->fetch.has_insn = FALSE;
+
+    while (cpu->execute.has_insn || cpu->memory.has_insn || cpu->writeback.has_insn)
+    {
+        if (APEX_writeback(cpu))
+        {
+            halted = TRUE;
+            break;
+        }
+
+        APEX_memory(cpu);
+        APEX_execute(cpu);
+        cpu->clock++;
+    }
+
+    memset(cpu->regs_state, 0, sizeof(cpu->regs_state));
+    cpu->decode.has_insn = FALSE;
+    cpu->stall_pipeline = 0;
+    cpu->fetch_from_next_cycle = FALSE;
+    cpu->fetch.has_insn = !halted;
+    return halted;
+}
+
+/*
+ * Cycle loop of APEX_cpu_run for cycles nobody looks at: no output, no
+ * trace and no check for either. Runs until the clock reaches stop.
+ * Returns RUN_HALTED when HALT retires, else RUN_CONTINUE
+ */
+static int
+run_quiet(APEX_CPU *cpu, int stop)
+{
+    int idle;
+
+    while (cpu->clock < stop)
+    {
+        if (cpu->simulate_cycle(cpu))
+        {
+            return RUN_HALTED;
+        }
+        cpu->clock++;
+
+        idle = idle_cycles(cpu);
+        if (idle > stop - cpu->clock)
+        {
+            idle = stop - cpu->clock;
+        }
+        skip_idle_cycles(cpu, idle);
+    }
+    return RUN_CONTINUE;
+}
+
+/*
+ * Simulates cycles without the per-cycle state dump until HALT retires or
+ * the clock reaches stop, which idle cycles are not skipped past.
+ * Returns TRUE if HALT retired
+ */
+int
+APEX_cpu_step_until(APEX_CPU *cpu, int stop)
+{
+    return run_quiet(cpu, stop) == RUN_HALTED;
+}
+
+/*
+ * Cycle loop of APEX_cpu_run for cycles in the display window or traced:
+ * prints each cycle at cpu->log_level, records it to the trace and waits
+ * for the user when single-stepping. Idle cycles are skipped only when
+ * none of that is printed, and traced as one TRACE_IDLE event that
+ * apex_trace_decode prints cycle by cycle. Runs until the clock reaches stop.
+ * Returns RUN_HALTED when HALT retires, RUN_STOPPED when the user quits,
+ * else RUN_CONTINUE
+ */
+static int
+run_observed(APEX_CPU *cpu, int stop)
+{
+    char user_prompt_val;
+    int idle;
+
+    while (cpu->clock < stop)
+    {
+        if (cpu->log_level >= LOG_PIPELINE)
+        {
+            fprintf(cpu->out, "--------------------------------------------\n");
+            fprintf(cpu->out, "Clock Cycle #: %d\n", cpu->clock);
+            fprintf(cpu->out, "--------------------------------------------\n");
+        }
+        if (cpu->trace)
+        {
+            APEX_trace_value(cpu->trace, TRACE_CYCLE, cpu->clock, 0, 0);
+        }
+
+        if (cpu->observe_cycle(cpu))
+        {
+            /* Halt in writeback stage */
+            if (cpu->trace)
+            {
+                APEX_trace_value(cpu->trace, TRACE_HALT, cpu->clock, 0, cpu->insn_completed);
+            }
+            return RUN_HALTED;
+        }
+
+        if (cpu->log_level >= LOG_STATE)
+        {
+            APEX_cpu_print_state(cpu);
+        }
+
+        if (cpu->single_step)
+        {
+            fprintf(cpu->out, "Press any key to advance CPU Clock or <q> to quit:\n");
+            scanf("%c", &user_prompt_val);
+
+            if ((user_prompt_val == 'Q') || (user_prompt_val == 'q'))
+            {
+                fprintf(cpu->out, "APEX_CPU: Simulation Stopped, cycles = %d instructions = %d\n", cpu->clock, cpu->insn_completed);
+                return RUN_STOPPED;
+            }
+        }
+
+        cpu->clock++;
+
+        if (cpu->log_level == LOG_QUIET && !cpu->single_step)
+        {
+            idle = idle_cycles(cpu);
+            if (idle > stop - cpu->clock)
+            {
+                idle = stop - cpu->clock;
+            }
+            if (idle > 0)
+            {
+                if (cpu->trace)
+                {
+                    APEX_trace_value(cpu->trace, TRACE_IDLE, cpu->clock, 0,
+                                     cpu->clock + idle - 1);
+                }
+                skip_idle_cycles(cpu, idle);
+            }
+        }
+    }
+    return RUN_CONTINUE;
+}
+
+/*
+ * APEX CPU simulation loop. Simulates at most numCycles cycles, switching
+ * between run_quiet and run_observed where the display window
+ * [display_from, display_to] starts and ends; a traced run is observed
+ * throughout. Returns TRUE if HALT retired
+ *
+ * Note: You are free to edit this function according to your implementation
+ */
+int APEX_cpu_run(APEX_CPU *cpu, int numCycles)
+{
+    int end = (numCycles > INT_MAX - cpu->clock) ? INT_MAX : cpu->clock + numCycles;
+    int status = RUN_CONTINUE;
+    int stop;
+
+    while (status == RUN_CONTINUE && cpu->clock < end)
+    {
+        if (cpu->trace)
+        {
+            status = run_observed(cpu, end);
+        }
+        else if (cpu->log_level == LOG_QUIET || cpu->clock > cpu->display_to)
+        {
+            status = run_quiet(cpu, end);
+        }
+        else if (cpu->clock < cpu->display_from)
+        {
+            stop = (cpu->display_from < end) ? cpu->display_from : end;
+            status = run_quiet(cpu, stop);
+        }
+        else
+        {
+            stop = (cpu->display_to < end - 1) ? cpu->display_to + 1 : end;
+            status = run_observed(cpu, stop);
+        }
+    }
+
+    if (status == RUN_HALTED && cpu->out)
+    {
+        fprintf(cpu->out, "APEX_CPU: Simulation Complete, cycles = %d instructions = %d\n",
+                cpu->clock, cpu->insn_completed);
+        fflush(cpu->out);
+    }
+    return status == RUN_HALTED;
+}
+
+/*
+ * This function deallocates APEX CPU.
+ *
+ * Note: You are free to edit this function according to your implementation
+ */
+void APEX_cpu_stop(APEX_CPU *cpu)
+{
+    if (ENABLE_LATCH_STATS)
+    {
+        fprintf(stderr, "APEX_CPU: Latch copies = %lu bytes, %.1f bytes/cycle\n",
+                cpu->latch_copy_bytes,
+                cpu->clock ? (double)cpu->latch_copy_bytes / cpu->clock : 0.0);
+    }
+
+    APEX_dbt_free(cpu);
+    free(cpu->profile);
+    free(cpu->threaded_code);
+    free(cpu->code_memory);
+    free(cpu->filename);
+    free(cpu);
+}
\ No newline at end of file
@@ -0,0 +1,328 @@
+/*
+ * apex_cpu.h
+ * Contains APEX cpu pipeline declarations
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#ifndef _APEX_CPU_H_
+#define _APEX_CPU_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "apex_macros.h"
+
+struct APEX_CPU;
+struct APEX_DBT;
+
+/* Lanes of the lockstep engine, see apex_lockstep.c */
+typedef struct APEX_Lockstep APEX_Lockstep;
+
+/* Binary trace being written, see apex_trace.c */
+typedef struct APEX_Trace APEX_Trace;
+
+/* Background writer of text output, see apex_log.c */
+typedef struct APEX_Log APEX_Log;
+
+/* Execute stage handler, returns the value the P/Z/N flags are set from */
+typedef int (*APEX_Exec_Handler)(struct APEX_CPU *cpu);
+
+/* Opcode descriptor, one per OPCODE_* value, see apex_opcodes in apex_cpu.c */
+typedef struct APEX_Opcode_Info
+{
+    uint8_t operands[3];       /* OPERAND_* in assembly order, for parsing and printing */
+    uint8_t src;               /* ROLE_* registers read in decode */
+    uint8_t dst;               /* ROLE_* registers written in writeback */
+    uint8_t flags;             /* FLAGS_* effect on the P/Z/N flags */
+    uint8_t memory;            /* MEM_* access in the memory stage */
+    uint8_t latency;           /* Cycles spent in the execute stage */
+    APEX_Exec_Handler execute; /* Execute stage logic */
+    int dropped_in_decode;     /* Never issued, overwritten by the next fetch (NOP) */
+} APEX_Opcode_Info;
+
+/* Pre-decoded APEX instruction (micro-op), built once by create_code_memory.
+ * Laid out to 32 bytes so two entries share a cache line */
+typedef struct APEX_Instruction
+{
+    const char *opcode_str;    /* Mnemonic as written in the input file, display only */
+    const APEX_Opcode_Info *info; /* Descriptor of this opcode */
+    int imm;
+    unsigned int src_mask;     /* Registers read in decode */
+    unsigned int dst_mask;     /* Registers held in the scoreboard until writeback */
+    uint8_t opcode;
+    uint8_t rd;
+    uint8_t rs1;
+    uint8_t rs2;
+} APEX_Instruction;
+
+/* Model of CPU stage latch, copied between stages every cycle so it is kept
+ * within one cache line */
+typedef struct CPU_Stage
+{
+    const APEX_Instruction *insn; /* Instruction in this latch, points into code memory */
+    int pc;
+    int rs1_value;
+    int rs2_value;
+    int result_buffer;
+    int memory_address;
+    uint8_t has_insn;
+    uint8_t cycles_left; /* Cycles left in execute */
+} CPU_Stage;
+
+/* Values most recently forwarded into decode by the forwarding policy,
+ * from the EX/MEM latch (ex_*) and the MEM/WB latch (mem_*) */
+typedef struct CPU_Bypass
+{
+    int ex_tag_forwarded;
+    int ex_value_forwarded;
+    int ex_forwarded;
+    int mem_tag_forwarded;
+    int mem_value_forwarded;
+    int mem_forwarded;
+} CPU_Bypass;
+
+/*
+ * One fixed-size binary trace event. Fields not listed for a type are 0:
+ *
+ *   TRACE_CYCLE  cycle about to be simulated
+ *   TRACE_STAGE  stage, addr (latch pc) and opcode of a latch holding an
+ *                instruction; for decode also stall (STALL_* bits) and
+ *                the forwarded registers (tag) and values
+ *   TRACE_REG    register addr written back with value[0]
+ *   TRACE_MEM    data memory address addr stored with value[0]
+ *   TRACE_FLAGS  TRACE_FLAG_* bits in value[0]
+ *   TRACE_IDLE   cycles cycle to value[0] skipped with execute busy
+ *   TRACE_HALT   HALT retired after cycle cycles, value[0] instructions
+ */
+typedef struct APEX_Trace_Event
+{
+    int32_t cycle;
+    int32_t addr;
+    int32_t value[2];          /* Forwarded from EX/MEM and MEM/WB for decode */
+    uint8_t type;              /* TRACE_* */
+    uint8_t stage;             /* STAGE_* */
+    uint8_t opcode;
+    uint8_t stall;
+    uint8_t forwarded;         /* TRACE_FORWARD_* */
+    uint8_t tag[2];
+    uint8_t reserved;
+} APEX_Trace_Event;
+
+/* Start of a trace file, see apex_trace.c */
+typedef struct APEX_Trace_Header
+{
+    char magic[8];             /* TRACE_MAGIC */
+    uint32_t version;          /* TRACE_VERSION */
+    uint32_t header_size;      /* sizeof(APEX_Trace_Header) */
+    uint32_t event_size;       /* sizeof(APEX_Trace_Event) */
+    uint32_t program_len;      /* Length of the input file path */
+} APEX_Trace_Header;
+
+/* Instruction of a program image: the fields create_code_memory parses
+ * from a line of text, in a fixed 8 bytes */
+typedef struct APEX_Binary_Insn
+{
+    int32_t imm;
+    uint8_t opcode;            /* OPCODE_* */
+    uint8_t rd;
+    uint8_t rs1;
+    uint8_t rs2;
+} APEX_Binary_Insn;
+
+/* Data memory word set before a program image starts */
+typedef struct APEX_Binary_Data
+{
+    int32_t addr;
+    int32_t value;
+} APEX_Binary_Data;
+
+/* Name of a code address in a program image */
+typedef struct APEX_Binary_Symbol
+{
+    int32_t addr;
+    char name[SECTION_NAME_SIZE];
+} APEX_Binary_Symbol;
+
+/* Start of a program image (.apexbin) written by apex-as, followed by
+ * insn_count APEX_Binary_Insn, data_count APEX_Binary_Data and
+ * symbol_count APEX_Binary_Symbol, in host byte order */
+typedef struct APEX_Binary_Header
+{
+    char magic[8];             /* BINARY_MAGIC */
+    uint32_t version;          /* BINARY_VERSION */
+    uint32_t header_size;      /* sizeof(APEX_Binary_Header) */
+    uint32_t insn_size;        /* sizeof(APEX_Binary_Insn) */
+    uint32_t insn_count;
+    uint32_t data_count;
+    uint32_t symbol_count;
+} APEX_Binary_Header;
+
+/* Performance counters of the pipeline since the CPU was created or
+ * restored, see APEX_cpu_write_counters */
+typedef struct APEX_Counters
+{
+    long stalls[NUM_STALL_CAUSES]; /* Decode stall cycles by STALL_CAUSE_* */
+    long forward_memory;       /* Instructions issued with a value forwarded from the MEM latch */
+    long forward_writeback;    /* Same, from the WB latch */
+    long branch_flushes;       /* Taken branches and jumps redirecting fetch */
+    long squashed_fetches;     /* Instructions flushed from decode by them */
+    long retired[NUM_OPCODES]; /* Instructions retired per opcode */
+    long bubbles[NUM_STAGES];  /* Cycles each stage held no instruction */
+} APEX_Counters;
+
+/* Profile of one code memory entry since profiling was enabled, see
+ * apex_profile.c. An instruction spends one cycle in writeback, so
+ * stage_cycles[STAGE_WRITEBACK] is also its retire count */
+typedef struct APEX_Profile_Entry
+{
+    long stage_cycles[NUM_STAGES]; /* Cycles the instruction spent in each stage */
+    long stalls[NUM_STALL_CAUSES]; /* Cycles it was held in decode by STALL_CAUSE_* */
+    long caused;               /* Decode stall cycles of others waiting on it */
+} APEX_Profile_Entry;
+
+/* Model of APEX CPU */
+typedef struct APEX_CPU
+{
+    int pc;             /* Current program counter */
+    int clock;          /* Clock cycles elapsed */
+    int insn_completed; /* Instructions retired */
+    long functional_insns; /* Instructions retired by the functional model */
+    int stall_pipeline;
+    int stall_cycles;   /* Cycles an instruction was held in decode */
+    int stall_reason;   /* STALL_* bits of the last cycle held in decode */
+    int stall_cause;    /* STALL_CAUSE_* of that cycle */
+    const CPU_Stage *stall_producer; /* Latch it waited on in that cycle, or NULL */
+    APEX_Counters counters;
+    APEX_Profile_Entry *profile;       /* Per code memory entry, NULL unless profiled */
+    int regs[REG_FILE_SIZE];           /* Integer register file */
+    int regs_state[REG_FILE_SIZE];     /* Tracks state of the register for scoreboarding (valid/invalid)*/
+    char *filename;                    /* Input file, recorded in checkpoints */
+    int code_memory_size;              /* Number of instruction in the input file */
+    APEX_Instruction *code_memory;     /* Code Memory */
+    const void **threaded_code;        /* Functional handler per code memory entry, see APEX_cpu_thread_code */
+    struct APEX_DBT *dbt;              /* Translated code cache, see apex_dbt.c */
+    int use_dbt;                       /* Fast-forward through translated code */
+    int data_memory[DATA_MEMORY_SIZE]; /* Data Memory */
+    uint64_t mem_written[DATA_MEMORY_SIZE / 64]; /* Bitmap of the words in mem_index */
+    uint16_t mem_index[DATA_MEMORY_SIZE]; /* Words stored to, in address order, see APEX_cpu_store */
+    int mem_index_len;
+    uint64_t mem_changed[DATA_MEMORY_SIZE / 64]; /* Bitmap of the words in mem_delta */
+    uint16_t mem_delta[DATA_MEMORY_SIZE]; /* Words stored to since the last APEX_cpu_print_state */
+    int mem_delta_len;
+    int mem_delta_view;                /* Print only mem_delta instead of all nonzero words */
+    int single_step;                   /* Wait for user input after every displayed cycle */
+    FILE *out;                         /* Simulation output, NULL for a silent CPU */
+    APEX_Trace *trace;                 /* Binary trace of APEX_cpu_run, see apex_trace.c */
+    int log_level;                     /* LOG_* output of the displayed cycles, needs out */
+    int display_from;                  /* First and last cycle displayed, see APEX_cpu_run */
+    int display_to;
+    int zero_flag;                     /* {TRUE, FALSE} Used by BZ and BNZ to branch */
+    int positive_flag;                 /* {TRUE, FALSE} Used by BP and BNP to branch */
+    int negative_flag;                 /* {TRUE, FALSE} Used by BN and BNN to branch */
+    int fetch_from_next_cycle;
+    int fetch_before_stall;
+    uint8_t latency[NUM_OPCODES];      /* Execute cycles per opcode, from apex_opcodes unless a sweep changes them */
+    unsigned long latch_copy_bytes;    /* Bytes copied between latches, see ENABLE_LATCH_STATS */
+    int hazard;                        /* HAZARD_* policy, see APEX_cpu_set_hazard */
+    int (*simulate_cycle)(struct APEX_CPU *cpu); /* Runs one cycle under that policy, profiled with profile */
+    int (*observe_cycle)(struct APEX_CPU *cpu);  /* Same, reporting every stage */
+    CPU_Bypass bypass;                 /* Forwarding paths into decode */
+    /* Pipeline stages */
+    CPU_Stage fetch;
+    CPU_Stage decode;
+    CPU_Stage execute;
+    CPU_Stage memory;
+    CPU_Stage writeback;
+} APEX_CPU;
+
+/* Result of a sampled simulation, see APEX_cpu_run_sampled */
+typedef struct APEX_Sample_Stats
+{
+    long samples;          /* Measurement units taken */
+    long insns;            /* Instructions retired, functional and detailed */
+    double cpi_mean;       /* Mean CPI over the measurement units */
+    double cpi_stddev;     /* Sample standard deviation of the unit CPIs */
+    double cpi_ci95;       /* Half-width of the 95% confidence interval of the mean */
+    double est_cycles;     /* cpi_mean * insns */
+} APEX_Sample_Stats;
+
+/* Result of a parallel interval simulation, see APEX_cpu_run_intervals */
+typedef struct APEX_Interval_Stats
+{
+    long intervals;        /* Intervals simulated */
+    long insns;            /* Instructions retired in the measured intervals */
+    long est_cycles;       /* Sum of the interval cycle counts */
+} APEX_Interval_Stats;
+
+/* Program to simulate: one section of an input file, see APEX_batch_collect */
+typedef struct APEX_Program
+{
+    char *path;
+    int section;
+    char name[SECTION_NAME_SIZE]; /* Section header, empty for a single program */
+} APEX_Program;
+
+APEX_Instruction *create_code_memory(const char *filename, int section, int *size);
+int get_code_sections(const char *filename, char names[][SECTION_NAME_SIZE], int max);
+int *get_code_lines(const char *filename, int section, int *size);
+int get_data_memory_init(const char *filename, APEX_Binary_Data **data);
+const APEX_Opcode_Info *APEX_get_opcode_info(int opcode);
+int get_opcode_from_string(const char *mnemonic);
+const char *get_opcode_name(int opcode);
+APEX_CPU *APEX_cpu_init(const char *filename);
+APEX_CPU *APEX_cpu_create(const char *filename, int section, FILE *out);
+void APEX_cpu_print_code_memory(const APEX_CPU *cpu);
+int APEX_cpu_run(APEX_CPU *cpu, int numCycles);
+int APEX_cpu_write_counters(const APEX_CPU *cpu, int halted, FILE *out);
+int APEX_cpu_enable_profile(APEX_CPU *cpu);
+int APEX_cpu_write_profile(const APEX_CPU *cpu, int section, FILE *out);
+int APEX_cpu_step(APEX_CPU *cpu);
+int APEX_cpu_step_until(APEX_CPU *cpu, int stop);
+int APEX_cpu_step_insns(APEX_CPU *cpu, long n);
+int APEX_cpu_drain(APEX_CPU *cpu);
+int APEX_cpu_thread_code(APEX_CPU *cpu);
+const char *APEX_cpu_dispatch_name(void);
+const char *APEX_hazard_name(int policy);
+int APEX_hazard_from_string(const char *name);
+void APEX_cpu_set_hazard(APEX_CPU *cpu, int policy);
+void APEX_cpu_print_stage(const APEX_CPU *cpu, int stage);
+void APEX_cpu_print_state(APEX_CPU *cpu);
+void APEX_cpu_store(APEX_CPU *cpu, int addr, int value);
+void APEX_cpu_index_memory(APEX_CPU *cpu);
+void APEX_cpu_reset_pipeline(APEX_CPU *cpu, int halted);
+int APEX_cpu_interpret(APEX_CPU *cpu, long max_insns, int stop_pc);
+int APEX_cpu_fast_forward(APEX_CPU *cpu, long max_insns, int stop_pc);
+int APEX_dbt_run(APEX_CPU *cpu, long max_insns, int stop_pc);
+void APEX_dbt_free(APEX_CPU *cpu);
+void APEX_cpu_run_sampled(APEX_CPU *cpu, long period, long unit, long warmup,
+                          APEX_Sample_Stats *stats);
+int APEX_cpu_run_intervals(APEX_CPU *cpu, long interval, long warmup, int threads,
+                           APEX_Interval_Stats *stats);
+int APEX_cpu_save(APEX_CPU *cpu, const char *path);
+APEX_CPU *APEX_cpu_restore(const char *path);
+void APEX_cpu_stop(APEX_CPU *cpu);
+int APEX_batch_collect(const char *source, APEX_Program **programs);
+void APEX_batch_free(APEX_Program *programs, int count);
+void APEX_program_label(const APEX_Program *program, char *buf, size_t size);
+void APEX_run_parallel(int count, int threads, void (*job)(void *arg, int i), void *arg);
+int APEX_batch_run(const char *source, int hazard, int threads, int max_cycles, FILE *out);
+int APEX_sweep_run(const char *source, const char *grid, int hazard, int threads,
+                   int max_cycles, FILE *out);
+int APEX_selfbench_run(const char *source, int trials, int warmup, int max_cycles, FILE *out);
+APEX_Trace *APEX_trace_open(const char *path, const APEX_CPU *cpu);
+void APEX_trace_stage(APEX_Trace *trace, const APEX_CPU *cpu, int stage,
+                      const CPU_Stage *latch);
+void APEX_trace_value(APEX_Trace *trace, int type, int cycle, int addr, int value);
+int APEX_trace_close(APEX_Trace *trace);
+APEX_Log *APEX_log_open(FILE *target);
+FILE *APEX_log_stream(APEX_Log *log);
+int APEX_log_close(APEX_Log *log);
+APEX_Lockstep *APEX_lockstep_create(const char *filename, int section, int lanes, int hazard);
+void APEX_lockstep_set_lane(APEX_Lockstep *ls, int lane, const APEX_CPU *cpu);
+int APEX_lockstep_get_lane(const APEX_Lockstep *ls, int lane, APEX_CPU *cpu);
+int APEX_lockstep_run(APEX_Lockstep *ls, int max_cycles);
+int APEX_lockstep_peak_groups(const APEX_Lockstep *ls);
+void APEX_lockstep_free(APEX_Lockstep *ls);
+#endif
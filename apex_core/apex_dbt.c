@@ -0,0 +1,830 @@
+/*
+ * apex_dbt.c
+ * Contains the dynamic binary translator of the functional model: APEX basic
+ * blocks are translated to x86-64 code on first execution, cached by PC and
+ * chained to each other. Anything the translator does not handle (DIV,
+ * out of range registers or data memory addresses, stop conditions falling
+ * inside a block) runs in the interpreter instead, so results are always
+ * the same as with APEX_cpu_interpret.
+ *
+ * Translated code keeps
+ *   rbx = cpu->regs, r12 = cpu->data_memory, r14 = cpu,
+ *   r13 = instructions left to execute, r15 = DBT_Context
+ * and returns to the dispatcher with the next PC in eax.
+ */
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_cpu.h"
+#include "apex_macros.h"
+
+#if ENABLE_DBT
+
+#include <sys/mman.h>
+
+/* Translation limits */
+#define DBT_CODE_SIZE (4 << 20)
+#define DBT_MAX_BLOCK 64
+#define DBT_MAX_BLOCK_BYTES (DBT_MAX_BLOCK * 96 + 256)
+
+/* DBT_Context.status when translated code returns */
+#define DBT_CONTINUE 0x0 /* Block ended, continue at the returned PC */
+#define DBT_HALTED 0x1   /* HALT retired */
+#define DBT_BAIL 0x2     /* Interpret from the returned PC */
+
+/* Host registers, by x86-64 encoding */
+#define EAX 0x0
+#define ECX 0x1
+#define EDX 0x2
+
+/* Shared with translated code through r15 */
+typedef struct DBT_Context
+{
+    long budget;         /* Instructions left, kept in r13 while running */
+    int stop_pc;         /* Blocks containing this PC bail out on entry */
+    int status;          /* DBT_* */
+} DBT_Context;
+
+/* Exit of a block waiting for its target block to be translated */
+typedef struct DBT_Patch
+{
+    uint8_t *rel;        /* rel32 of the exit jump */
+    struct DBT_Patch *next;
+} DBT_Patch;
+
+/* Translation cache entry, one per code memory index */
+typedef struct DBT_Block
+{
+    uint8_t *code;       /* Host code, NULL until translated */
+    int untranslatable;  /* First instruction is left to the interpreter */
+    DBT_Patch *pending;  /* Exits to chain once this block is translated */
+} DBT_Block;
+
+typedef struct APEX_DBT
+{
+    uint8_t *buffer;     /* Executable code buffer */
+    size_t used;
+    uint8_t *epilogue;   /* Returns from translated code to the dispatcher */
+    int (*enter)(APEX_CPU *cpu, const uint8_t *code, DBT_Context *ctx);
+    DBT_Block *blocks;   /* Indexed like code memory */
+} APEX_DBT;
+
+/* Byte emitter over the code buffer */
+typedef struct DBT_Emitter
+{
+    uint8_t *p;
+} DBT_Emitter;
+
+static void
+emit8(DBT_Emitter *e, int byte)
+{
+    *e->p++ = (uint8_t)byte;
+}
+
+static void
+emit32(DBT_Emitter *e, int32_t value)
+{
+    memcpy(e->p, &value, sizeof(value));
+    e->p += sizeof(value);
+}
+
+/* Points the rel32 at rel to target */
+static void
+patch_rel32(uint8_t *rel, const uint8_t *target)
+{
+    int32_t value = (int32_t)(target - (rel + 4));
+
+    memcpy(rel, &value, sizeof(value));
+}
+
+/* jmp/jcc rel32 to target, returns the address of the rel32 */
+static uint8_t *
+emit_jmp(DBT_Emitter *e, const uint8_t *target)
+{
+    uint8_t *rel;
+
+    emit8(e, 0xE9);
+    rel = e->p;
+    emit32(e, 0);
+    patch_rel32(rel, target);
+    return rel;
+}
+
+static uint8_t *
+emit_jcc(DBT_Emitter *e, int cc, const uint8_t *target)
+{
+    uint8_t *rel;
+
+    emit8(e, 0x0F);
+    emit8(e, 0x80 | cc);
+    rel = e->p;
+    emit32(e, 0);
+    if (target)
+    {
+        patch_rel32(rel, target);
+    }
+    return rel;
+}
+
+/* Condition codes */
+#define CC_B 0x2
+#define CC_AE 0x3
+#define CC_NE 0x5
+#define CC_L 0xC
+
+/* mov r32, regs[r] */
+static void
+emit_load_reg(DBT_Emitter *e, int host, int r)
+{
+    emit8(e, 0x8B);
+    emit8(e, 0x43 | (host << 3));
+    emit8(e, r * 4);
+}
+
+/* mov regs[r], r32 */
+static void
+emit_store_reg(DBT_Emitter *e, int host, int r)
+{
+    emit8(e, 0x89);
+    emit8(e, 0x43 | (host << 3));
+    emit8(e, r * 4);
+}
+
+/* mov r32, imm32 */
+static void
+emit_mov_imm(DBT_Emitter *e, int host, int32_t imm)
+{
+    emit8(e, 0xB8 + host);
+    emit32(e, imm);
+}
+
+/* add eax, imm32 */
+static void
+emit_add_eax_imm(DBT_Emitter *e, int32_t imm)
+{
+    emit8(e, 0x05);
+    emit32(e, imm);
+}
+
+/* mov [r14 + offset], r32 */
+static void
+emit_store_cpu(DBT_Emitter *e, int host, size_t offset)
+{
+    emit8(e, 0x41);
+    emit8(e, 0x89);
+    emit8(e, 0x86 | (host << 3));
+    emit32(e, (int32_t)offset);
+}
+
+/* cmp dword [r14 + offset], imm8 */
+static void
+emit_cmp_cpu(DBT_Emitter *e, size_t offset, int imm)
+{
+    emit8(e, 0x41);
+    emit8(e, 0x83);
+    emit8(e, 0xBE);
+    emit32(e, (int32_t)offset);
+    emit8(e, imm);
+}
+
+/* mov dword [r15 + status], value */
+static void
+emit_set_status(DBT_Emitter *e, int status)
+{
+    emit8(e, 0x41);
+    emit8(e, 0xC7);
+    emit8(e, 0x47);
+    emit8(e, offsetof(DBT_Context, status));
+    emit32(e, status);
+}
+
+/* Sets the P, Z and N flags from eax, as set_flags in apex_functional.c */
+static void
+emit_set_flags(DBT_Emitter *e)
+{
+    static const uint8_t code[] = {
+        0x85, 0xC0,       /* test eax, eax */
+        0x0F, 0x94, 0xC1, /* setz cl */
+        0x0F, 0x9F, 0xC2, /* setg dl */
+        0x0F, 0x9C, 0xC0, /* setl al */
+        0x0F, 0xB6, 0xC9, /* movzx ecx, cl */
+        0x0F, 0xB6, 0xD2, /* movzx edx, dl */
+        0x0F, 0xB6, 0xC0, /* movzx eax, al */
+    };
+
+    memcpy(e->p, code, sizeof(code));
+    e->p += sizeof(code);
+    emit_store_cpu(e, ECX, offsetof(APEX_CPU, zero_flag));
+    emit_store_cpu(e, EDX, offsetof(APEX_CPU, positive_flag));
+    emit_store_cpu(e, EAX, offsetof(APEX_CPU, negative_flag));
+}
+
+/* eax = regs[rs1] <op> regs[rs2], with op one of add, sub, and, or, xor
+ * (opcode byte of "op r/m32, r32") or imul (0) */
+static void
+emit_alu(DBT_Emitter *e, int op, int rs1, int rs2)
+{
+    emit_load_reg(e, EAX, rs1);
+    emit_load_reg(e, ECX, rs2);
+    if (op)
+    {
+        emit8(e, op);
+        emit8(e, 0xC8);
+    }
+    else
+    {
+        emit8(e, 0x0F);
+        emit8(e, 0xAF);
+        emit8(e, 0xC1);
+    }
+}
+
+#define ALU_ADD 0x01
+#define ALU_SUB 0x29
+#define ALU_AND 0x21
+#define ALU_OR 0x09
+#define ALU_XOR 0x31
+#define ALU_IMUL 0x00
+
+/* eax = regs[base] + imm, leaving through side_exit unless it is a valid
+ * data memory index. Returns the rel32 of the side exit jump */
+static uint8_t *
+emit_address(DBT_Emitter *e, int base, int imm)
+{
+    emit_load_reg(e, EAX, base);
+    emit_add_eax_imm(e, imm);
+    emit8(e, 0x3D);                 /* cmp eax, DATA_MEMORY_SIZE */
+    emit32(e, DATA_MEMORY_SIZE);
+    return emit_jcc(e, CC_AE, NULL);
+}
+
+/*
+ * Exit to the block at target_pc: jumps straight to it when it is already
+ * translated, otherwise returns target_pc to the dispatcher and is queued to
+ * be chained once the target is translated
+ */
+static void
+emit_exit(APEX_DBT *dbt, APEX_CPU *cpu, DBT_Emitter *e, int target_pc)
+{
+    int index = (target_pc - 4000) / 4;
+    uint8_t *rel;
+    DBT_Patch *patch;
+
+    emit_mov_imm(e, EAX, target_pc);
+    rel = emit_jmp(e, dbt->epilogue);
+
+    if (target_pc < 4000 || (target_pc - 4000) % 4 != 0 || index >= cpu->code_memory_size)
+    {
+        return;
+    }
+    if (dbt->blocks[index].code)
+    {
+        patch_rel32(rel, dbt->blocks[index].code);
+        return;
+    }
+
+    patch = malloc(sizeof(*patch));
+    if (patch)
+    {
+        patch->rel = rel;
+        patch->next = dbt->blocks[index].pending;
+        dbt->blocks[index].pending = patch;
+    }
+}
+
+/* Side exit taken before the instruction at pc, with refund instructions of
+ * the block not executed */
+typedef struct DBT_Side_Exit
+{
+    uint8_t *rel;
+    int pc;
+    int refund;
+} DBT_Side_Exit;
+
+static int
+translatable(const APEX_Instruction *insn)
+{
+    if (insn->rd >= REG_FILE_SIZE || insn->rs1 >= REG_FILE_SIZE
+        || insn->rs2 >= REG_FILE_SIZE)
+    {
+        return FALSE;
+    }
+
+    switch (insn->opcode)
+    {
+    case OPCODE_DIV:
+        return FALSE;
+
+    default:
+        return TRUE;
+    }
+}
+
+/* Ends a basic block */
+static int
+is_block_end(int opcode)
+{
+    switch (opcode)
+    {
+    case OPCODE_BZ:
+    case OPCODE_BNZ:
+    case OPCODE_BP:
+    case OPCODE_BNP:
+    case OPCODE_BN:
+    case OPCODE_BNN:
+    case OPCODE_JUMP:
+    case OPCODE_JALR:
+    case OPCODE_HALT:
+        return TRUE;
+
+    default:
+        return FALSE;
+    }
+}
+
+/* Translates the block starting at code memory index start. Returns FALSE
+ * if its first instruction has to be interpreted, or the buffer is full */
+static int
+translate_block(APEX_DBT *dbt, APEX_CPU *cpu, int start)
+{
+    DBT_Side_Exit side_exits[DBT_MAX_BLOCK];
+    DBT_Emitter emitter;
+    DBT_Emitter *e = &emitter;
+    DBT_Block *block = &dbt->blocks[start];
+    const APEX_Instruction *insn;
+    uint8_t *bail_stop, *bail_budget, *skip;
+    uint8_t *entry;
+    DBT_Patch *patch, *next;
+    int start_pc = 4000 + 4 * start;
+    int num_side_exits = 0;
+    int length = 0;
+    int counted = 0;
+    int ended = FALSE;
+    int i, pc, flag;
+
+    if (dbt->used + DBT_MAX_BLOCK_BYTES > DBT_CODE_SIZE)
+    {
+        return FALSE;
+    }
+
+    /* Extent of the block and the number of instructions it retires */
+    while (start + length < cpu->code_memory_size && length < DBT_MAX_BLOCK)
+    {
+        insn = &cpu->code_memory[start + length];
+        if (!translatable(insn))
+        {
+            break;
+        }
+        length++;
+        if (insn->opcode != OPCODE_NOP)
+        {
+            counted++;
+        }
+        if (is_block_end(insn->opcode))
+        {
+            ended = TRUE;
+            break;
+        }
+    }
+    /* A trailing NOP would run even when the budget ends just before it */
+    while (!ended && length > 0 && cpu->code_memory[start + length - 1].opcode == OPCODE_NOP)
+    {
+        length--;
+    }
+    if (length == 0)
+    {
+        block->untranslatable = TRUE;
+        return FALSE;
+    }
+
+    entry = dbt->buffer + dbt->used;
+    e->p = entry;
+
+    /* Bail out if stop_pc is inside the block: (stop_pc - start) < size */
+    emit8(e, 0x41);                 /* mov eax, [r15 + stop_pc] */
+    emit8(e, 0x8B);
+    emit8(e, 0x47);
+    emit8(e, offsetof(DBT_Context, stop_pc));
+    emit8(e, 0x2D);                 /* sub eax, start_pc */
+    emit32(e, start_pc);
+    emit8(e, 0x3D);                 /* cmp eax, 4 * length */
+    emit32(e, 4 * length);
+    bail_stop = emit_jcc(e, CC_B, NULL);
+
+    /* Or if fewer than counted instructions are left */
+    emit8(e, 0x49);                 /* cmp r13, counted */
+    emit8(e, 0x81);
+    emit8(e, 0xFD);
+    emit32(e, counted);
+    bail_budget = emit_jcc(e, CC_L, NULL);
+    emit8(e, 0x49);                 /* sub r13, counted */
+    emit8(e, 0x81);
+    emit8(e, 0xED);
+    emit32(e, counted);
+
+    pc = start_pc;
+    for (i = 0; i < length; ++i, pc += 4)
+    {
+        insn = &cpu->code_memory[start + i];
+
+        switch (insn->opcode)
+        {
+        case OPCODE_ADD:
+        case OPCODE_SUB:
+        case OPCODE_MUL:
+        case OPCODE_AND:
+        case OPCODE_OR:
+        case OPCODE_XOR:
+        {
+            emit_alu(e,
+                     insn->opcode == OPCODE_ADD ? ALU_ADD
+                     : insn->opcode == OPCODE_SUB ? ALU_SUB
+                     : insn->opcode == OPCODE_MUL ? ALU_IMUL
+                     : insn->opcode == OPCODE_AND ? ALU_AND
+                     : insn->opcode == OPCODE_OR ? ALU_OR
+                     : ALU_XOR,
+                     insn->rs1, insn->rs2);
+            emit_store_reg(e, EAX, insn->rd);
+            emit_set_flags(e);
+            break;
+        }
+
+        case OPCODE_ADDL:
+        case OPCODE_SUBL:
+        {
+            emit_load_reg(e, EAX, insn->rs1);
+            emit_add_eax_imm(e, insn->opcode == OPCODE_ADDL ? insn->imm : -(uint32_t)insn->imm);
+            emit_store_reg(e, EAX, insn->rd);
+            emit_set_flags(e);
+            break;
+        }
+
+        case OPCODE_CMP:
+        {
+            emit_alu(e, ALU_SUB, insn->rs1, insn->rs2);
+            emit_set_flags(e);
+            break;
+        }
+
+        case OPCODE_CML:
+        {
+            emit_load_reg(e, EAX, insn->rs1);
+            emit_add_eax_imm(e, -(uint32_t)insn->imm);
+            emit_set_flags(e);
+            break;
+        }
+
+        case OPCODE_MOVC:
+        {
+            emit_mov_imm(e, EAX, insn->imm);
+            emit_store_reg(e, EAX, insn->rd);
+            break;
+        }
+
+        case OPCODE_LOAD:
+        case OPCODE_LOADP:
+        {
+            side_exits[num_side_exits].rel = emit_address(e, insn->rs1, insn->imm);
+            side_exits[num_side_exits].pc = pc;
+            side_exits[num_side_exits].refund = counted;
+            num_side_exits++;
+            emit8(e, 0x41);         /* mov ecx, [r12 + rax * 4] */
+            emit8(e, 0x8B);
+            emit8(e, 0x0C);
+            emit8(e, 0x84);
+            if (insn->opcode == OPCODE_LOADP)
+            {
+                emit_load_reg(e, EDX, insn->rs1);
+                emit_store_reg(e, ECX, insn->rd);
+                emit8(e, 0x83);     /* add edx, 4 */
+                emit8(e, 0xC2);
+                emit8(e, 4);
+                emit_store_reg(e, EDX, insn->rs1);
+            }
+            else
+            {
+                emit_store_reg(e, ECX, insn->rd);
+            }
+            break;
+        }
+
+        case OPCODE_STORE:
+        case OPCODE_STOREP:
+        {
+            side_exits[num_side_exits].rel = emit_address(e, insn->rs2, insn->imm);
+            side_exits[num_side_exits].pc = pc;
+            side_exits[num_side_exits].refund = counted;
+            num_side_exits++;
+            emit_load_reg(e, ECX, insn->rs1);
+            emit8(e, 0x41);         /* mov [r12 + rax * 4], ecx */
+            emit8(e, 0x89);
+            emit8(e, 0x0C);
+            emit8(e, 0x84);
+            if (insn->opcode == OPCODE_STOREP)
+            {
+                emit_load_reg(e, EAX, insn->rs2);
+                emit_add_eax_imm(e, 4);
+                emit_store_reg(e, EAX, insn->rs2);
+            }
+            break;
+        }
+
+        case OPCODE_BZ:
+        case OPCODE_BNZ:
+        case OPCODE_BP:
+        case OPCODE_BNP:
+        case OPCODE_BN:
+        case OPCODE_BNN:
+        {
+            flag = (insn->opcode == OPCODE_BZ || insn->opcode == OPCODE_BNZ)
+                       ? offsetof(APEX_CPU, zero_flag)
+                   : (insn->opcode == OPCODE_BP || insn->opcode == OPCODE_BNP)
+                       ? offsetof(APEX_CPU, positive_flag)
+                       : offsetof(APEX_CPU, negative_flag);
+            emit_cmp_cpu(e, flag,
+                         (insn->opcode == OPCODE_BZ || insn->opcode == OPCODE_BP
+                          || insn->opcode == OPCODE_BN) ? TRUE : FALSE);
+            skip = emit_jcc(e, CC_NE, NULL);
+            emit_exit(dbt, cpu, e, pc + insn->imm);
+            patch_rel32(skip, e->p);
+            emit_exit(dbt, cpu, e, pc + 4);
+            break;
+        }
+
+        case OPCODE_JUMP:
+        {
+            emit_load_reg(e, EAX, insn->rs1);
+            emit_add_eax_imm(e, insn->imm);
+            emit_jmp(e, dbt->epilogue);
+            break;
+        }
+
+        case OPCODE_JALR:
+        {
+            emit_load_reg(e, EAX, insn->rs1);
+            emit_add_eax_imm(e, insn->imm);
+            emit_mov_imm(e, ECX, pc + 4);
+            emit_store_reg(e, ECX, insn->rd);
+            emit_jmp(e, dbt->epilogue);
+            break;
+        }
+
+        case OPCODE_HALT:
+        {
+            emit_set_status(e, DBT_HALTED);
+            emit_mov_imm(e, EAX, pc + 4);
+            emit_jmp(e, dbt->epilogue);
+            break;
+        }
+
+        case OPCODE_NOP:
+        default:
+            break;
+        }
+
+        if (insn->opcode != OPCODE_NOP)
+        {
+            counted--;
+        }
+    }
+
+    /* Fell off the end: block size limit, untranslatable instruction next,
+     * or end of code memory */
+    if (!ended)
+    {
+        emit_exit(dbt, cpu, e, pc);
+    }
+
+    /* Side exits refund the instructions not executed and interpret */
+    for (i = 0; i < num_side_exits; ++i)
+    {
+        patch_rel32(side_exits[i].rel, e->p);
+        emit8(e, 0x49);             /* add r13, refund */
+        emit8(e, 0x81);
+        emit8(e, 0xC5);
+        emit32(e, side_exits[i].refund);
+        emit_set_status(e, DBT_BAIL);
+        emit_mov_imm(e, EAX, side_exits[i].pc);
+        emit_jmp(e, dbt->epilogue);
+    }
+
+    patch_rel32(bail_stop, e->p);
+    patch_rel32(bail_budget, e->p);
+    emit_set_status(e, DBT_BAIL);
+    emit_mov_imm(e, EAX, start_pc);
+    emit_jmp(e, dbt->epilogue);
+
+    dbt->used = e->p - dbt->buffer;
+    block->code = entry;
+
+    /* Chain the blocks that were waiting for this one */
+    for (patch = block->pending; patch; patch = next)
+    {
+        next = patch->next;
+        patch_rel32(patch->rel, entry);
+        free(patch);
+    }
+    block->pending = NULL;
+    return TRUE;
+}
+
+/* Emits the entry trampoline and the shared epilogue */
+static void
+emit_trampoline(APEX_DBT *dbt)
+{
+    static const uint8_t prologue[] = {
+        0x53,             /* push rbx */
+        0x41, 0x54,       /* push r12 */
+        0x41, 0x55,       /* push r13 */
+        0x41, 0x56,       /* push r14 */
+        0x41, 0x57,       /* push r15 */
+    };
+    static const uint8_t epilogue[] = {
+        0x4D, 0x89, 0x2F, /* mov [r15], r13 */
+        0x41, 0x5F,       /* pop r15 */
+        0x41, 0x5E,       /* pop r14 */
+        0x41, 0x5D,       /* pop r13 */
+        0x41, 0x5C,       /* pop r12 */
+        0x5B,             /* pop rbx */
+        0xC3,             /* ret */
+    };
+    DBT_Emitter emitter;
+    DBT_Emitter *e = &emitter;
+
+    e->p = dbt->buffer;
+    dbt->enter = (int (*)(APEX_CPU *, const uint8_t *, DBT_Context *))(void *)e->p;
+    memcpy(e->p, prologue, sizeof(prologue));
+    e->p += sizeof(prologue);
+    emit8(e, 0x48);                 /* lea rbx, [rdi + regs] */
+    emit8(e, 0x8D);
+    emit8(e, 0x9F);
+    emit32(e, offsetof(APEX_CPU, regs));
+    emit8(e, 0x4C);                 /* lea r12, [rdi + data_memory] */
+    emit8(e, 0x8D);
+    emit8(e, 0xA7);
+    emit32(e, offsetof(APEX_CPU, data_memory));
+    emit8(e, 0x49);                 /* mov r14, rdi */
+    emit8(e, 0x89);
+    emit8(e, 0xFE);
+    emit8(e, 0x49);                 /* mov r15, rdx */
+    emit8(e, 0x89);
+    emit8(e, 0xD7);
+    emit8(e, 0x4C);                 /* mov r13, [rdx] */
+    emit8(e, 0x8B);
+    emit8(e, 0x2A);
+    emit8(e, 0xFF);                 /* jmp rsi */
+    emit8(e, 0xE6);
+
+    dbt->epilogue = e->p;
+    memcpy(e->p, epilogue, sizeof(epilogue));
+    e->p += sizeof(epilogue);
+    dbt->used = e->p - dbt->buffer;
+}
+
+static APEX_DBT *
+dbt_create(APEX_CPU *cpu)
+{
+    APEX_DBT *dbt = calloc(1, sizeof(*dbt));
+
+    if (!dbt)
+    {
+        return NULL;
+    }
+
+    dbt->blocks = calloc(cpu->code_memory_size, sizeof(DBT_Block));
+    dbt->buffer = mmap(NULL, DBT_CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (!dbt->blocks || dbt->buffer == MAP_FAILED)
+    {
+        if (dbt->buffer != MAP_FAILED)
+        {
+            munmap(dbt->buffer, DBT_CODE_SIZE);
+        }
+        free(dbt->blocks);
+        free(dbt);
+        return NULL;
+    }
+
+    emit_trampoline(dbt);
+    return dbt;
+}
+
+/*
+ * Functional execution through translated code, same contract as
+ * APEX_cpu_interpret. Falls back to the interpreter entirely if the code
+ * buffer can not be created.
+ */
+int
+APEX_dbt_run(APEX_CPU *cpu, long max_insns, int stop_pc)
+{
+    APEX_DBT *dbt = cpu->dbt;
+    long limit = (max_insns < 0) ? LONG_MAX : max_insns;
+    long executed = 0;
+    long before;
+    int pc = cpu->pc;
+    int halted = FALSE;
+    int index;
+    DBT_Context ctx;
+
+    if (!dbt)
+    {
+        dbt = cpu->dbt = dbt_create(cpu);
+        if (!dbt)
+        {
+            return APEX_cpu_interpret(cpu, max_insns, stop_pc);
+        }
+    }
+
+    while (executed < limit && pc != stop_pc)
+    {
+        index = (pc - 4000) / 4;
+        if (index < 0 || index >= cpu->code_memory_size)
+        {
+            break;
+        }
+
+        if ((pc - 4000) % 4 == 0
+            && (dbt->blocks[index].code
+                || (!dbt->blocks[index].untranslatable && translate_block(dbt, cpu, index))))
+        {
+            ctx.budget = limit - executed;
+            ctx.stop_pc = stop_pc;
+            ctx.status = DBT_CONTINUE;
+            pc = dbt->enter(cpu, dbt->blocks[index].code, &ctx);
+            executed = limit - ctx.budget;
+
+            if (ctx.status == DBT_HALTED)
+            {
+                halted = TRUE;
+                break;
+            }
+            if (ctx.status == DBT_CONTINUE)
+            {
+                continue;
+            }
+        }
+
+        /* Not translated, or bailed out: interpret a stretch of code */
+        cpu->pc = pc;
+        before = cpu->functional_insns;
+        halted = APEX_cpu_interpret(cpu, (limit - executed < DBT_MAX_BLOCK)
+                                             ? limit - executed : DBT_MAX_BLOCK,
+                                    stop_pc);
+        executed += cpu->functional_insns - before;
+        cpu->functional_insns = before;
+        pc = cpu->pc;
+        if (halted)
+        {
+            break;
+        }
+    }
+
+    cpu->pc = pc;
+    cpu->functional_insns += executed;
+    APEX_cpu_reset_pipeline(cpu, halted);
+    return halted;
+}
+
+/* Releases the translation cache */
+void
+APEX_dbt_free(APEX_CPU *cpu)
+{
+    APEX_DBT *dbt = cpu->dbt;
+    DBT_Patch *patch, *next;
+    int i;
+
+    if (!dbt)
+    {
+        return;
+    }
+    for (i = 0; i < cpu->code_memory_size; ++i)
+    {
+        for (patch = dbt->blocks[i].pending; patch; patch = next)
+        {
+            next = patch->next;
+            free(patch);
+        }
+    }
+    munmap(dbt->buffer, DBT_CODE_SIZE);
+    free(dbt->blocks);
+    free(dbt);
+    cpu->dbt = NULL;
+}
+
+#else
+
+int
+APEX_dbt_run(APEX_CPU *cpu, long max_insns, int stop_pc)
+{
+    return APEX_cpu_interpret(cpu, max_insns, stop_pc);
+}
+
+void
+APEX_dbt_free(APEX_CPU *cpu)
+{
+}
+
+#endif
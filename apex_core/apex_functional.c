@@ -0,0 +1,437 @@
+/*
+ * apex_functional.c
+ * Contains the functional (ISA-level) APEX interpreter, used to fast-forward
+ * the architectural state of an APEX_CPU before switching to the detailed
+ * pipeline model
+ */
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_cpu.h"
+#include "apex_macros.h"
+
+/* Sets the P, Z and N flags from an ALU or compare result */
+static void
+set_flags(APEX_CPU *cpu, int result)
+{
+    cpu->zero_flag = (result == 0) ? TRUE : FALSE;
+    cpu->positive_flag = (result > 0) ? TRUE : FALSE;
+    cpu->negative_flag = (result < 0) ? TRUE : FALSE;
+}
+
+/*
+ * Resets the pipeline to an empty state with fetch starting at cpu->pc,
+ * which is where the detailed model resumes after a fast-forward
+ */
+void
+APEX_cpu_reset_pipeline(APEX_CPU *cpu, int halted)
+{
+    memset(cpu->regs_state, 0, sizeof(cpu->regs_state));
+    memset(&cpu->fetch, 0, sizeof(CPU_Stage));
+    memset(&cpu->decode, 0, sizeof(CPU_Stage));
+    memset(&cpu->execute, 0, sizeof(CPU_Stage));
+    memset(&cpu->memory, 0, sizeof(CPU_Stage));
+    memset(&cpu->writeback, 0, sizeof(CPU_Stage));
+    cpu->stall_pipeline = 0;
+    cpu->fetch_from_next_cycle = FALSE;
+    cpu->fetch.has_insn = !halted;
+}
+
+/*
+ * Handler dispatch. With ENABLE_THREADED_DISPATCH every handler ends by
+ * fetching the next instruction and jumping straight to the handler address
+ * resolved for it at load time (cpu->threaded_code), so there is one
+ * indirect branch per handler instead of a shared switch. Otherwise the
+ * same handlers are the cases of a switch.
+ */
+#define FETCH()                                      \
+    do                                               \
+    {                                                \
+        if (executed == limit || pc == stop_pc)      \
+        {                                            \
+            goto done;                               \
+        }                                            \
+        index = (pc - 4000) / 4;                     \
+        if (index < 0 || index >= size)              \
+        {                                            \
+            goto done;                               \
+        }                                            \
+        insn = &code[index];                         \
+        pc += 4;                                     \
+        executed++;                                  \
+    } while (0)
+
+#if ENABLE_THREADED_DISPATCH
+#define HANDLER(op) L_##op:
+#define NEXT()                          \
+    do                                  \
+    {                                   \
+        FETCH();                        \
+        goto *threaded_code[index];     \
+    } while (0)
+#else
+#define HANDLER(op) case op:
+#define NEXT() continue
+#endif
+
+/*
+ * Functional core. When labels is not NULL it only returns the handler
+ * address of every opcode through it, for APEX_cpu_thread_code.
+ */
+static int
+functional_core(APEX_CPU *cpu, long max_insns, int stop_pc, const void *const **labels)
+{
+    const APEX_Instruction *code = cpu->code_memory;
+    int *regs = cpu->regs;
+    int *mem = cpu->data_memory;
+    int size = cpu->code_memory_size;
+    long limit = (max_insns < 0) ? LONG_MAX : max_insns;
+    long executed = 0;
+    int pc = cpu->pc;
+    int halted = FALSE;
+    int index, target;
+    const APEX_Instruction *insn;
+
+#if ENABLE_THREADED_DISPATCH
+    static const void *const handlers[NUM_OPCODES] = {
+        [0 ... NUM_OPCODES - 1] = &&L_invalid,
+        [OPCODE_ADD] = &&L_OPCODE_ADD,
+        [OPCODE_ADDL] = &&L_OPCODE_ADDL,
+        [OPCODE_SUB] = &&L_OPCODE_SUB,
+        [OPCODE_SUBL] = &&L_OPCODE_SUBL,
+        [OPCODE_MUL] = &&L_OPCODE_MUL,
+        [OPCODE_DIV] = &&L_OPCODE_DIV,
+        [OPCODE_AND] = &&L_OPCODE_AND,
+        [OPCODE_OR] = &&L_OPCODE_OR,
+        [OPCODE_XOR] = &&L_OPCODE_XOR,
+        [OPCODE_CMP] = &&L_OPCODE_CMP,
+        [OPCODE_CML] = &&L_OPCODE_CML,
+        [OPCODE_MOVC] = &&L_OPCODE_MOVC,
+        [OPCODE_LOAD] = &&L_OPCODE_LOAD,
+        [OPCODE_LOADP] = &&L_OPCODE_LOADP,
+        [OPCODE_STORE] = &&L_OPCODE_STORE,
+        [OPCODE_STOREP] = &&L_OPCODE_STOREP,
+        [OPCODE_BZ] = &&L_OPCODE_BZ,
+        [OPCODE_BNZ] = &&L_OPCODE_BNZ,
+        [OPCODE_BP] = &&L_OPCODE_BP,
+        [OPCODE_BNP] = &&L_OPCODE_BNP,
+        [OPCODE_BN] = &&L_OPCODE_BN,
+        [OPCODE_BNN] = &&L_OPCODE_BNN,
+        [OPCODE_JUMP] = &&L_OPCODE_JUMP,
+        [OPCODE_JALR] = &&L_OPCODE_JALR,
+        [OPCODE_NOP] = &&L_OPCODE_NOP,
+        [OPCODE_HALT] = &&L_OPCODE_HALT,
+    };
+    const void **threaded_code = cpu->threaded_code;
+
+    if (labels)
+    {
+        *labels = handlers;
+        return FALSE;
+    }
+
+    NEXT();
+#else
+    (void)labels;
+
+    for (;;)
+    {
+        FETCH();
+
+        switch (insn->opcode)
+        {
+#endif
+
+    HANDLER(OPCODE_ADD)
+    {
+        regs[insn->rd] = regs[insn->rs1] + regs[insn->rs2];
+        set_flags(cpu, regs[insn->rd]);
+        NEXT();
+    }
+
+    HANDLER(OPCODE_ADDL)
+    {
+        regs[insn->rd] = regs[insn->rs1] + insn->imm;
+        set_flags(cpu, regs[insn->rd]);
+        NEXT();
+    }
+
+    HANDLER(OPCODE_SUB)
+    {
+        regs[insn->rd] = regs[insn->rs1] - regs[insn->rs2];
+        set_flags(cpu, regs[insn->rd]);
+        NEXT();
+    }
+
+    HANDLER(OPCODE_SUBL)
+    {
+        regs[insn->rd] = regs[insn->rs1] - insn->imm;
+        set_flags(cpu, regs[insn->rd]);
+        NEXT();
+    }
+
+    HANDLER(OPCODE_MUL)
+    {
+        regs[insn->rd] = regs[insn->rs1] * regs[insn->rs2];
+        set_flags(cpu, regs[insn->rd]);
+        NEXT();
+    }
+
+    HANDLER(OPCODE_DIV)
+    {
+        /* Same convention as the execute stage: x / 0 yields 0 */
+        if (regs[insn->rs2] == 0
+            || (regs[insn->rs1] == INT_MIN && regs[insn->rs2] == -1))
+        {
+            regs[insn->rd] = 0;
+        }
+        else
+        {
+            regs[insn->rd] = regs[insn->rs1] / regs[insn->rs2];
+        }
+        set_flags(cpu, regs[insn->rd]);
+        NEXT();
+    }
+
+    HANDLER(OPCODE_AND)
+    {
+        regs[insn->rd] = regs[insn->rs1] & regs[insn->rs2];
+        set_flags(cpu, regs[insn->rd]);
+        NEXT();
+    }
+
+    HANDLER(OPCODE_OR)
+    {
+        regs[insn->rd] = regs[insn->rs1] | regs[insn->rs2];
+        set_flags(cpu, regs[insn->rd]);
+        NEXT();
+    }
+
+    HANDLER(OPCODE_XOR)
+    {
+        regs[insn->rd] = regs[insn->rs1] ^ regs[insn->rs2];
+        set_flags(cpu, regs[insn->rd]);
+        NEXT();
+    }
+
+    HANDLER(OPCODE_CMP)
+    {
+        set_flags(cpu, regs[insn->rs1] - regs[insn->rs2]);
+        NEXT();
+    }
+
+    HANDLER(OPCODE_CML)
+    {
+        set_flags(cpu, regs[insn->rs1] - insn->imm);
+        NEXT();
+    }
+
+    HANDLER(OPCODE_MOVC)
+    {
+        regs[insn->rd] = insn->imm;
+        NEXT();
+    }
+
+    HANDLER(OPCODE_LOAD)
+    {
+        regs[insn->rd] = mem[regs[insn->rs1] + insn->imm];
+        NEXT();
+    }
+
+    HANDLER(OPCODE_LOADP)
+    {
+        /* The post-incremented base is written after rd, as in writeback */
+        target = regs[insn->rs1];
+        regs[insn->rd] = mem[target + insn->imm];
+        regs[insn->rs1] = target + 4;
+        NEXT();
+    }
+
+    HANDLER(OPCODE_STORE)
+    {
+        mem[regs[insn->rs2] + insn->imm] = regs[insn->rs1];
+        NEXT();
+    }
+
+    HANDLER(OPCODE_STOREP)
+    {
+        mem[regs[insn->rs2] + insn->imm] = regs[insn->rs1];
+        regs[insn->rs2] += 4;
+        NEXT();
+    }
+
+    HANDLER(OPCODE_BZ)
+    {
+        if (cpu->zero_flag == TRUE)
+        {
+            pc = pc - 4 + insn->imm;
+        }
+        NEXT();
+    }
+
+    HANDLER(OPCODE_BNZ)
+    {
+        if (cpu->zero_flag == FALSE)
+        {
+            pc = pc - 4 + insn->imm;
+        }
+        NEXT();
+    }
+
+    HANDLER(OPCODE_BP)
+    {
+        if (cpu->positive_flag == TRUE)
+        {
+            pc = pc - 4 + insn->imm;
+        }
+        NEXT();
+    }
+
+    HANDLER(OPCODE_BNP)
+    {
+        if (cpu->positive_flag == FALSE)
+        {
+            pc = pc - 4 + insn->imm;
+        }
+        NEXT();
+    }
+
+    HANDLER(OPCODE_BN)
+    {
+        if (cpu->negative_flag == TRUE)
+        {
+            pc = pc - 4 + insn->imm;
+        }
+        NEXT();
+    }
+
+    HANDLER(OPCODE_BNN)
+    {
+        if (cpu->negative_flag == FALSE)
+        {
+            pc = pc - 4 + insn->imm;
+        }
+        NEXT();
+    }
+
+    HANDLER(OPCODE_JUMP)
+    {
+        pc = regs[insn->rs1] + insn->imm;
+        NEXT();
+    }
+
+    HANDLER(OPCODE_JALR)
+    {
+        target = regs[insn->rs1] + insn->imm;
+        regs[insn->rd] = pc;
+        pc = target;
+        NEXT();
+    }
+
+    HANDLER(OPCODE_NOP)
+    {
+        /* Dropped in decode by the pipeline, so it does not retire */
+        executed--;
+        NEXT();
+    }
+
+    HANDLER(OPCODE_HALT)
+    {
+        halted = TRUE;
+        goto done;
+    }
+
+#if ENABLE_THREADED_DISPATCH
+L_invalid:
+    NEXT();
+#else
+        default:
+            NEXT();
+        }
+    }
+#endif
+
+done:
+    cpu->pc = pc;
+    cpu->functional_insns += executed;
+    APEX_cpu_reset_pipeline(cpu, halted);
+
+    return halted;
+}
+
+/*
+ * Resolves the handler of every code memory entry, including the sentinel
+ * past the end, for threaded dispatch. Called once when the program is
+ * loaded. Returns 0 on success, -1 if out of memory.
+ */
+int
+APEX_cpu_thread_code(APEX_CPU *cpu)
+{
+#if ENABLE_THREADED_DISPATCH
+    const void *const *handlers;
+    int i;
+
+    functional_core(cpu, 0, -1, &handlers);
+
+    cpu->threaded_code = malloc((cpu->code_memory_size + 1) * sizeof(void *));
+    if (!cpu->threaded_code)
+    {
+        return -1;
+    }
+    for (i = 0; i <= cpu->code_memory_size; ++i)
+    {
+        cpu->threaded_code[i] = handlers[cpu->code_memory[i].opcode];
+    }
+#else
+    cpu->threaded_code = NULL;
+#endif
+    return 0;
+}
+
+/* Dispatch the functional core was built with, for reports */
+const char *
+APEX_cpu_dispatch_name(void)
+{
+    return ENABLE_THREADED_DISPATCH ? "threaded" : "switch";
+}
+
+/*
+ * Executes instructions at ISA level, without pipeline timing, starting at
+ * cpu->pc. Stops after max_insns retired instructions (no limit when
+ * negative), when the PC reaches stop_pc (ignored when negative), on HALT,
+ * or when the PC leaves code memory.
+ *
+ * Must be called with an empty pipeline, i.e. before APEX_cpu_run. On
+ * return the pipeline is reset to fetch from cpu->pc.
+ *
+ * Returns TRUE if HALT was retired.
+ */
+int
+APEX_cpu_interpret(APEX_CPU *cpu, long max_insns, int stop_pc)
+{
+    return functional_core(cpu, max_insns, stop_pc, NULL);
+}
+
+/*
+ * Functional fast-forward, see APEX_cpu_interpret. Runs translated host
+ * code instead of the interpreter when cpu->use_dbt is set, see apex_dbt.c
+ */
+int
+APEX_cpu_fast_forward(APEX_CPU *cpu, long max_insns, int stop_pc)
+{
+    int halted;
+
+    if (ENABLE_DBT && cpu->use_dbt)
+    {
+        halted = APEX_dbt_run(cpu, max_insns, stop_pc);
+    }
+    else
+    {
+        halted = functional_core(cpu, max_insns, stop_pc, NULL);
+    }
+
+    /* Both store to data memory directly */
+    APEX_cpu_index_memory(cpu);
+    return halted;
+}
@@ -0,0 +1,232 @@
+/*
+ * apex_interval.c
+ * Contains the parallel interval simulation mode: the functional model cuts
+ * the program into intervals of a fixed number of instructions and each
+ * interval is simulated in the detailed pipeline on its own host thread,
+ * starting from a snapshot of the architectural state
+ */
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_cpu.h"
+#include "apex_macros.h"
+
+/* Interval waiting for a worker */
+typedef struct Interval_Work
+{
+    APEX_CPU *cpu;   /* Snapshot, shares code memory with the original CPU */
+    long warmup;     /* Instructions to run before measuring */
+} Interval_Work;
+
+/* Bounded queue between the functional model and the workers, so only a
+ * few snapshots are alive at any time */
+typedef struct Interval_Queue
+{
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    Interval_Work *work;
+    int capacity;
+    int head;
+    int count;
+    int done;            /* No more intervals will be queued */
+    long interval;       /* Instructions measured per interval */
+    long cycles;         /* Sum of the measured cycles */
+    long insns;          /* Sum of the measured instructions */
+} Interval_Queue;
+
+static void
+queue_push(Interval_Queue *q, APEX_CPU *cpu, long warmup)
+{
+    pthread_mutex_lock(&q->lock);
+    while (q->count == q->capacity)
+    {
+        pthread_cond_wait(&q->not_full, &q->lock);
+    }
+    q->work[(q->head + q->count) % q->capacity].cpu = cpu;
+    q->work[(q->head + q->count) % q->capacity].warmup = warmup;
+    q->count++;
+    pthread_cond_signal(&q->not_empty);
+    pthread_mutex_unlock(&q->lock);
+}
+
+/* Returns FALSE once the queue is empty and closed */
+static int
+queue_pop(Interval_Queue *q, Interval_Work *work)
+{
+    pthread_mutex_lock(&q->lock);
+    while (q->count == 0 && !q->done)
+    {
+        pthread_cond_wait(&q->not_empty, &q->lock);
+    }
+    if (q->count == 0)
+    {
+        pthread_mutex_unlock(&q->lock);
+        return FALSE;
+    }
+    *work = q->work[q->head];
+    q->head = (q->head + 1) % q->capacity;
+    q->count--;
+    pthread_cond_signal(&q->not_full);
+    pthread_mutex_unlock(&q->lock);
+    return TRUE;
+}
+
+static void
+queue_close(Interval_Queue *q)
+{
+    pthread_mutex_lock(&q->lock);
+    q->done = TRUE;
+    pthread_cond_broadcast(&q->not_empty);
+    pthread_mutex_unlock(&q->lock);
+}
+
+/* Warms up the pipeline, then counts the cycles taken by the next
+ * interval of instructions, or until HALT */
+static void *
+interval_worker(void *arg)
+{
+    Interval_Queue *q = arg;
+    Interval_Work work;
+    long cycles, insns;
+    int start_clock, start_insns;
+
+    while (queue_pop(q, &work))
+    {
+        cycles = 0;
+        insns = 0;
+        if (!APEX_cpu_step_insns(work.cpu, work.warmup))
+        {
+            start_clock = work.cpu->clock;
+            start_insns = work.cpu->insn_completed;
+            APEX_cpu_step_insns(work.cpu, q->interval);
+            cycles = work.cpu->clock - start_clock;
+            insns = work.cpu->insn_completed - start_insns;
+        }
+        free(work.cpu);
+
+        pthread_mutex_lock(&q->lock);
+        q->cycles += cycles;
+        q->insns += insns;
+        pthread_mutex_unlock(&q->lock);
+    }
+    return NULL;
+}
+
+/* Copies the architectural state of cpu, with an empty pipeline */
+static APEX_CPU *
+snapshot(const APEX_CPU *cpu)
+{
+    APEX_CPU *copy = malloc(sizeof(*copy));
+
+    if (copy)
+    {
+        *copy = *cpu;
+        copy->log_level = LOG_QUIET;
+        copy->single_step = FALSE;
+        copy->clock = 0;
+        copy->insn_completed = 0;
+    }
+    return copy;
+}
+
+/*
+ * Parallel interval simulation. Interval i covers instructions
+ * [i * interval, (i + 1) * interval). Its snapshot is taken warmup
+ * instructions earlier by the functional model, and the detailed model runs
+ * those warmup instructions unmeasured to fill the pipeline. Interval 0
+ * starts from reset and needs no warmup. The estimated cycle count is the
+ * sum of the measured interval cycles.
+ *
+ * cpu must be freshly initialized; it is left at the end of the program.
+ * Returns 0 on success, -1 if the worker threads could not be created.
+ */
+int
+APEX_cpu_run_intervals(APEX_CPU *cpu, long interval, long warmup, int threads,
+                       APEX_Interval_Stats *stats)
+{
+    Interval_Queue q;
+    pthread_t *workers;
+    APEX_CPU *copy;
+    long position = 0;
+    long next, start;
+    int started = 0;
+    int i, ret = 0;
+
+    memset(stats, 0, sizeof(*stats));
+    if (warmup > interval)
+    {
+        warmup = interval;
+    }
+
+    memset(&q, 0, sizeof(q));
+    pthread_mutex_init(&q.lock, NULL);
+    pthread_cond_init(&q.not_empty, NULL);
+    pthread_cond_init(&q.not_full, NULL);
+    q.capacity = 2 * threads;
+    q.interval = interval;
+    q.work = calloc(q.capacity, sizeof(Interval_Work));
+    workers = calloc(threads, sizeof(pthread_t));
+    if (!q.work || !workers)
+    {
+        ret = -1;
+        goto out;
+    }
+
+    for (i = 0; i < threads; ++i)
+    {
+        if (pthread_create(&workers[i], NULL, interval_worker, &q) != 0)
+        {
+            ret = -1;
+            break;
+        }
+        started++;
+    }
+
+    for (i = 0; ret == 0; ++i)
+    {
+        start = (long)i * interval;
+        next = (i == 0) ? 0 : start - warmup;
+
+        if (next > position)
+        {
+            if (APEX_cpu_fast_forward(cpu, next - position, -1))
+            {
+                break;
+            }
+            position = next;
+        }
+        /* Fast-forward ran off the end of code memory */
+        if (cpu->pc < 4000 || cpu->pc >= 4000 + 4 * cpu->code_memory_size)
+        {
+            break;
+        }
+
+        copy = snapshot(cpu);
+        if (!copy)
+        {
+            ret = -1;
+            break;
+        }
+        queue_push(&q, copy, start - position);
+        stats->intervals++;
+    }
+
+    queue_close(&q);
+    for (i = 0; i < started; ++i)
+    {
+        pthread_join(workers[i], NULL);
+    }
+
+    stats->insns = q.insns;
+    stats->est_cycles = q.cycles;
+
+out:
+    free(workers);
+    free(q.work);
+    pthread_cond_destroy(&q.not_full);
+    pthread_cond_destroy(&q.not_empty);
+    pthread_mutex_destroy(&q.lock);
+    return ret;
+}
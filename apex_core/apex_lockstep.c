@@ -0,0 +1,1147 @@
+/*
+ * apex_lockstep.c
+ * Contains the lockstep engine: many copies of one program, each with its
+ * own data (a lane), simulated together in the pipeline.
+ *
+ * Pipeline timing only depends on the instructions in flight, never on the
+ * values they carry, so lanes that follow the same path share one copy of
+ * the pipeline control state (a group). Register file, flags, data memory
+ * and the value fields of every latch are kept per lane in
+ * structure-of-arrays form, and each stage updates the values of all lanes
+ * of a group with vector operations, under the group's lane mask.
+ *
+ * A branch that goes different ways in different lanes splits its group,
+ * and groups that reach the same pipeline state merge again, so every lane
+ * reproduces the cycle count and results of a scalar APEX_CPU.
+ */
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_cpu.h"
+#include "apex_macros.h"
+
+/* LOCKSTEP_WIDTH 32-bit lanes, one SSE or AVX2 register */
+typedef int Lane_Vec __attribute__((vector_size(LOCKSTEP_WIDTH * sizeof(int))));
+
+#define VEC(array, i) (*(Lane_Vec *)&(array)[i])
+
+/* Iterates i over the vectors holding the lanes of group g */
+#define FOR_EACH_VEC(g, i) for ((i) = (g)->lo; (i) < (g)->hi; (i) += LOCKSTEP_WIDTH)
+
+/* Iterates lane over the lanes of group g */
+#define FOR_EACH_LANE(g, lane) \
+    for ((lane) = (g)->lo; (lane) < (g)->hi; ++(lane)) \
+        if ((g)->mask[lane])
+
+/* Per-lane values of a pipeline latch, see CPU_Stage */
+typedef struct Lane_Latch
+{
+    int *rs1_value;
+    int *rs2_value;
+    int *result_buffer;
+    int *memory_address;
+} Lane_Latch;
+
+/* Control part of a pipeline latch, shared by the lanes of a group */
+typedef struct Group_Latch
+{
+    const APEX_Instruction *insn;
+    int pc;
+    uint8_t has_insn;
+    uint8_t cycles_left;
+} Group_Latch;
+
+/* Lanes following the same path through the program, and their pipeline
+ * control state */
+typedef struct Lane_Group
+{
+    int *mask;          /* -1 for the lanes of this group, 0 otherwise */
+    int lo;             /* First vector holding a lane of this group */
+    int hi;             /* End of the last vector holding one */
+    int pc;
+    int stall_pipeline;
+    int fetch_from_next_cycle;
+    int halted;         /* HALT retired, dropped at the end of the cycle */
+    int regs_state[REG_FILE_SIZE];
+    Group_Latch fetch;
+    Group_Latch decode;
+    Group_Latch execute;
+    Group_Latch memory;
+    Group_Latch writeback;
+} Lane_Group;
+
+struct APEX_Lockstep
+{
+    int lanes;               /* Lanes simulated */
+    int width;               /* lanes rounded up to LOCKSTEP_WIDTH */
+    int clock;
+    APEX_Instruction *code_memory;
+    int code_memory_size;
+    int *regs;               /* [REG_FILE_SIZE][width] */
+    int *data_memory;        /* [DATA_MEMORY_SIZE][width] */
+    int *zero_flag;
+    int *positive_flag;
+    int *negative_flag;
+    int *insn_completed;
+    int *halt_clock;         /* Cycle HALT retired in each lane, -1 before */
+    int *scratch;            /* Per-lane branch outcomes and targets */
+    Lane_Latch decode;       /* Fetch never writes its value fields */
+    Lane_Latch execute;
+    Lane_Latch memory;
+    Lane_Latch writeback;
+    Lane_Group **groups;
+    int num_groups;
+    int peak_groups;
+    void (*decode_stage)(APEX_Lockstep *ls, Lane_Group *g); /* Of the hazard policy */
+};
+
+static int *
+alloc_lanes(const APEX_Lockstep *ls, size_t rows)
+{
+    int *p = aligned_alloc(sizeof(Lane_Vec), rows * ls->width * sizeof(int));
+
+    if (p)
+    {
+        memset(p, 0, rows * ls->width * sizeof(int));
+    }
+    return p;
+}
+
+/* dst = src in the lanes of g */
+static void
+masked_copy(int *dst, const int *src, const Lane_Group *g)
+{
+    Lane_Vec m;
+    int i;
+
+    FOR_EACH_VEC(g, i)
+    {
+        m = VEC(g->mask, i);
+        VEC(dst, i) = (VEC(src, i) & m) | (VEC(dst, i) & ~m);
+    }
+}
+
+/* dst = value in the lanes of g */
+static void
+masked_set(int *dst, int value, const Lane_Group *g)
+{
+    Lane_Vec m;
+    int i;
+
+    FOR_EACH_VEC(g, i)
+    {
+        m = VEC(g->mask, i);
+        VEC(dst, i) = (value & m) | (VEC(dst, i) & ~m);
+    }
+}
+
+static void
+copy_lane_latch(Lane_Latch *dst, const Lane_Latch *src, const Lane_Group *g)
+{
+    masked_copy(dst->rs1_value, src->rs1_value, g);
+    masked_copy(dst->rs2_value, src->rs2_value, g);
+    masked_copy(dst->result_buffer, src->result_buffer, g);
+    masked_copy(dst->memory_address, src->memory_address, g);
+}
+
+/* Recomputes the vector span of a group's lanes */
+static void
+update_span(Lane_Group *g, int width)
+{
+    int lane;
+
+    g->lo = width;
+    g->hi = 0;
+    for (lane = 0; lane < width; ++lane)
+    {
+        if (g->mask[lane])
+        {
+            if (g->lo == width)
+            {
+                g->lo = lane - lane % LOCKSTEP_WIDTH;
+            }
+            g->hi = lane - lane % LOCKSTEP_WIDTH + LOCKSTEP_WIDTH;
+        }
+    }
+}
+
+static int
+add_group(APEX_Lockstep *ls, Lane_Group *g)
+{
+    Lane_Group **grown = realloc(ls->groups, (ls->num_groups + 1) * sizeof(Lane_Group *));
+
+    if (!grown)
+    {
+        return -1;
+    }
+    ls->groups = grown;
+    ls->groups[ls->num_groups++] = g;
+    if (ls->num_groups > ls->peak_groups)
+    {
+        ls->peak_groups = ls->num_groups;
+    }
+    return 0;
+}
+
+static void
+free_group(Lane_Group *g)
+{
+    if (g)
+    {
+        free(g->mask);
+        free(g);
+    }
+}
+
+/*
+ * Moves the lanes of g that are nonzero in lanes into a new group in the
+ * same pipeline state. Returns the new group, or NULL if out of memory
+ */
+static Lane_Group *
+split_group(APEX_Lockstep *ls, Lane_Group *g, const int *lanes)
+{
+    Lane_Group *split = malloc(sizeof(Lane_Group));
+    int lane;
+
+    if (!split)
+    {
+        return NULL;
+    }
+    *split = *g;
+    split->mask = alloc_lanes(ls, 1);
+    if (!split->mask || add_group(ls, split) != 0)
+    {
+        free_group(split);
+        return NULL;
+    }
+
+    FOR_EACH_LANE(g, lane)
+    {
+        if (lanes[lane])
+        {
+            split->mask[lane] = -1;
+            g->mask[lane] = 0;
+        }
+    }
+    update_span(g, ls->width);
+    update_span(split, ls->width);
+    return split;
+}
+
+/* Latches without an instruction match whatever they last held */
+static int
+same_latch(const Group_Latch *a, const Group_Latch *b)
+{
+    return a->has_insn == b->has_insn
+           && (!a->has_insn
+               || (a->insn == b->insn && a->pc == b->pc && a->cycles_left == b->cycles_left));
+}
+
+/* TRUE when two groups are in the same pipeline state */
+static int
+same_state(const Lane_Group *a, const Lane_Group *b)
+{
+    return a->pc == b->pc && a->stall_pipeline == b->stall_pipeline
+           && a->fetch_from_next_cycle == b->fetch_from_next_cycle
+           && memcmp(a->regs_state, b->regs_state, sizeof(a->regs_state)) == 0
+           && same_latch(&a->fetch, &b->fetch) && same_latch(&a->decode, &b->decode)
+           && same_latch(&a->execute, &b->execute) && same_latch(&a->memory, &b->memory)
+           && same_latch(&a->writeback, &b->writeback);
+}
+
+/* Folds groups whose paths have reconverged into one */
+static void
+merge_groups(APEX_Lockstep *ls)
+{
+    Lane_Group *a, *b;
+    int i, j, k;
+
+    for (i = 0; i < ls->num_groups; ++i)
+    {
+        a = ls->groups[i];
+        for (j = i + 1; j < ls->num_groups;)
+        {
+            b = ls->groups[j];
+            if (!same_state(a, b))
+            {
+                ++j;
+                continue;
+            }
+
+            FOR_EACH_VEC(b, k)
+            {
+                VEC(a->mask, k) |= VEC(b->mask, k);
+            }
+            a->lo = a->lo < b->lo ? a->lo : b->lo;
+            a->hi = a->hi > b->hi ? a->hi : b->hi;
+            free_group(b);
+            ls->groups[j] = ls->groups[--ls->num_groups];
+        }
+    }
+}
+
+/* Redirects fetch to target and flushes the younger instruction in decode */
+static void
+take_branch(Lane_Group *g, int target)
+{
+    g->pc = target;
+    g->fetch_from_next_cycle = TRUE;
+    g->decode.has_insn = FALSE;
+    g->fetch.has_insn = TRUE;
+}
+
+static int
+source_registers_ready(const Lane_Group *g, unsigned int src_mask)
+{
+    while (src_mask)
+    {
+        if (g->regs_state[__builtin_ctz(src_mask)])
+        {
+            return FALSE;
+        }
+        src_mask &= src_mask - 1;
+    }
+
+    return TRUE;
+}
+
+static void
+set_destination_registers(Lane_Group *g, unsigned int dst_mask, int state)
+{
+    while (dst_mask)
+    {
+        g->regs_state[__builtin_ctz(dst_mask)] = state;
+        dst_mask &= dst_mask - 1;
+    }
+}
+
+static void
+fetch_stage(APEX_Lockstep *ls, Lane_Group *g)
+{
+    int index;
+
+    if (!g->fetch.has_insn)
+    {
+        return;
+    }
+    if (g->fetch_from_next_cycle == TRUE)
+    {
+        g->fetch_from_next_cycle = FALSE;
+        return;
+    }
+
+    /* A lane jumping out of the program fetches the empty entry past its
+     * end instead of running off code memory */
+    index = (g->pc - 4000) / 4;
+    if (g->pc < 4000 || index > ls->code_memory_size)
+    {
+        index = ls->code_memory_size;
+    }
+    g->fetch.pc = g->pc;
+    g->fetch.insn = &ls->code_memory[index];
+
+    if (g->stall_pipeline == 0)
+    {
+        g->pc += 4;
+        g->decode = g->fetch;
+        masked_set(ls->decode.rs1_value, 0, g);
+        masked_set(ls->decode.rs2_value, 0, g);
+        masked_set(ls->decode.result_buffer, 0, g);
+        masked_set(ls->decode.memory_address, 0, g);
+    }
+
+    if (g->fetch.insn->opcode == OPCODE_HALT && g->stall_pipeline == 0)
+    {
+        g->fetch.has_insn = FALSE;
+    }
+}
+
+/*
+ * Hazard policies of apex_cpu.c for a group. Each reads the source
+ * operands of the instruction in decode into the lanes of the group and
+ * returns TRUE once all of them are available; the checks only depend on
+ * the instructions in flight, so they are made once for the group.
+ */
+static int
+read_operands_stalling(APEX_Lockstep *ls, Lane_Group *g)
+{
+    const APEX_Instruction *insn = g->decode.insn;
+
+    if (!source_registers_ready(g, insn->src_mask))
+    {
+        return FALSE;
+    }
+
+    /* Sources are read from the register file once written back */
+    if (insn->info->src & ROLE_RS1)
+    {
+        masked_copy(ls->decode.rs1_value, &ls->regs[insn->rs1 * ls->width], g);
+    }
+    if (insn->info->src & ROLE_RS2)
+    {
+        masked_copy(ls->decode.rs2_value, &ls->regs[insn->rs2 * ls->width], g);
+    }
+    return TRUE;
+}
+
+/*
+ * Reads a source operand into dst with the forwarding of
+ * FORWARDED_DECODER_MUX_RS1/RS2: the tag checks are made once for the
+ * group, then the selected latch or register is copied in every lane.
+ * ex_result is the latch forwarded for the rd of the instruction in
+ * memory, the execute latch for RS1 and the memory latch for RS2.
+ */
+static void
+forwarded_decoder_mux(APEX_Lockstep *ls, Lane_Group *g, int reg, const int *ex_result,
+                      int *dst)
+{
+    const APEX_Instruction *m = g->memory.insn;
+    const APEX_Instruction *w = g->writeback.insn;
+    const int *src = &ls->regs[reg * ls->width];
+
+    if (g->memory.has_insn && m->opcode != OPCODE_LOADP && m->opcode != OPCODE_LOAD
+        && reg == m->rd)
+    {
+        src = ex_result;
+    }
+    else if (g->memory.has_insn && m->opcode == OPCODE_STOREP && reg == m->rs2)
+    {
+        src = ls->memory.rs2_value;
+    }
+    else if (g->memory.has_insn && m->opcode == OPCODE_LOADP && reg == m->rs1)
+    {
+        src = ls->memory.rs1_value;
+    }
+    else if (g->writeback.has_insn && reg == w->rd)
+    {
+        src = ls->writeback.result_buffer;
+    }
+    else if (g->writeback.has_insn && w->opcode == OPCODE_STOREP && reg == w->rs2)
+    {
+        src = ls->writeback.rs2_value;
+    }
+    else if (g->writeback.has_insn && w->opcode == OPCODE_LOADP && reg == w->rs1)
+    {
+        src = ls->writeback.rs1_value;
+    }
+
+    if (src != &ls->regs[reg * ls->width])
+    {
+        g->regs_state[reg] = 0;
+    }
+    masked_copy(dst, src, g);
+}
+
+static int
+read_operands_forwarding(APEX_Lockstep *ls, Lane_Group *g)
+{
+    const APEX_Instruction *insn = g->decode.insn;
+
+    if (insn->info->src & ROLE_RS1)
+    {
+        forwarded_decoder_mux(ls, g, insn->rs1, ls->execute.result_buffer,
+                              ls->decode.rs1_value);
+    }
+    if (insn->info->src & ROLE_RS2)
+    {
+        forwarded_decoder_mux(ls, g, insn->rs2, ls->memory.result_buffer,
+                              ls->decode.rs2_value);
+    }
+    return source_registers_ready(g, insn->src_mask);
+}
+
+/* Lane values of reg as written back by the group's instruction in latch,
+ * NULL if it is the rd of a load that has not read data memory yet */
+static const int *
+latch_row(const Group_Latch *latch, const Lane_Latch *values, int reg, int loaded)
+{
+    const APEX_Instruction *insn = latch->insn;
+
+    /* Reverse of the writeback order, the last write wins */
+    if ((insn->info->dst & ROLE_RS2) && insn->rs2 == reg)
+    {
+        return values->rs2_value;
+    }
+    if ((insn->info->dst & ROLE_RS1) && insn->rs1 == reg)
+    {
+        return values->rs1_value;
+    }
+    if (insn->info->memory == MEM_LOAD && !loaded)
+    {
+        return NULL;
+    }
+    return values->result_buffer;
+}
+
+/* Lane values of reg from the youngest instruction past execute that
+ * writes it, else from the register file */
+static const int *
+bypass_row(const APEX_Lockstep *ls, const Lane_Group *g, int reg)
+{
+    const unsigned int bit = 1u << reg;
+
+    if (g->memory.has_insn && (g->memory.insn->dst_mask & bit))
+    {
+        return latch_row(&g->memory, &ls->memory, reg, FALSE);
+    }
+    if (g->writeback.has_insn && (g->writeback.insn->dst_mask & bit))
+    {
+        return latch_row(&g->writeback, &ls->writeback, reg, TRUE);
+    }
+    return &ls->regs[reg * ls->width];
+}
+
+static int
+read_operands_bypass(APEX_Lockstep *ls, Lane_Group *g)
+{
+    const APEX_Instruction *insn = g->decode.insn;
+    const int *rs1 = NULL;
+    const int *rs2 = NULL;
+
+    if ((insn->info->src & ROLE_RS1) && !(rs1 = bypass_row(ls, g, insn->rs1)))
+    {
+        return FALSE;
+    }
+    if ((insn->info->src & ROLE_RS2) && !(rs2 = bypass_row(ls, g, insn->rs2)))
+    {
+        return FALSE;
+    }
+
+    if (rs1)
+    {
+        masked_copy(ls->decode.rs1_value, rs1, g);
+    }
+    if (rs2)
+    {
+        masked_copy(ls->decode.rs2_value, rs2, g);
+    }
+    return TRUE;
+}
+
+static void
+issue_when_ready(APEX_Lockstep *ls, Lane_Group *g, int ready)
+{
+    const APEX_Instruction *insn = g->decode.insn;
+
+    if (!g->execute.has_insn && ready)
+    {
+        set_destination_registers(g, insn->dst_mask, 1);
+        g->execute = g->decode;
+        copy_lane_latch(&ls->execute, &ls->decode, g);
+        g->execute.cycles_left = insn->info->latency;
+        g->decode.has_insn = FALSE;
+        g->stall_pipeline = 0;
+    }
+    else
+    {
+        g->stall_pipeline = 1;
+    }
+}
+
+/* Decode stage of a group under the policy whose read_operands_<policy>
+ * resolves the sources, as DEFINE_HAZARD_POLICY in apex_cpu.c */
+#define DEFINE_DECODE_STAGE(policy)                                           \
+    static void                                                               \
+    decode_stage_##policy(APEX_Lockstep *ls, Lane_Group *g)                   \
+    {                                                                         \
+        if (g->decode.has_insn && !g->decode.insn->info->dropped_in_decode)   \
+        {                                                                     \
+            issue_when_ready(ls, g, read_operands_##policy(ls, g));           \
+        }                                                                     \
+    }
+
+DEFINE_DECODE_STAGE(stalling)
+DEFINE_DECODE_STAGE(forwarding)
+DEFINE_DECODE_STAGE(bypass)
+
+#undef DEFINE_DECODE_STAGE
+
+/* Decode stages by HAZARD_* value */
+static void (*const lockstep_decode_stages[NUM_HAZARD_POLICIES])(APEX_Lockstep *ls,
+                                                                  Lane_Group *g) = {
+    [HAZARD_STALLING] = decode_stage_stalling,
+    [HAZARD_FORWARDING] = decode_stage_forwarding,
+    [HAZARD_BYPASS] = decode_stage_bypass,
+};
+
+/* Division in every lane, with the scalar pipeline's handling of the cases
+ * C leaves undefined */
+static void
+divide_lanes(APEX_Lockstep *ls, Lane_Group *g)
+{
+    const int *a = ls->execute.rs1_value;
+    const int *b = ls->execute.rs2_value;
+    int lane;
+
+    FOR_EACH_LANE(g, lane)
+    {
+        if (b[lane] == 0 || (a[lane] == INT_MIN && b[lane] == -1))
+        {
+            ls->execute.result_buffer[lane] = 0;
+        }
+        else
+        {
+            ls->execute.result_buffer[lane] = a[lane] / b[lane];
+        }
+        ls->scratch[lane] = ls->execute.result_buffer[lane];
+    }
+}
+
+/*
+ * The execute handlers of apex_cpu.c for every lane of g. Flag-setting
+ * results go to scratch, branch conditions to scratch as -1/0 and jump
+ * targets to scratch
+ */
+static void
+execute_lanes(APEX_Lockstep *ls, Lane_Group *g)
+{
+    const APEX_Instruction *insn = g->execute.insn;
+    Lane_Latch *ex = &ls->execute;
+    Lane_Vec a, b, r, m, cond;
+    int i;
+
+    if (insn->opcode == OPCODE_DIV)
+    {
+        divide_lanes(ls, g);
+        return;
+    }
+
+    FOR_EACH_VEC(g, i)
+    {
+        m = VEC(g->mask, i);
+        a = VEC(ex->rs1_value, i);
+        b = VEC(ex->rs2_value, i);
+        r = a - a;
+        cond = r;
+
+        switch (insn->opcode)
+        {
+        case OPCODE_ADD: r = a + b; break;
+        case OPCODE_ADDL: r = a + insn->imm; break;
+        case OPCODE_SUB: r = a - b; break;
+        case OPCODE_SUBL: r = a - insn->imm; break;
+        case OPCODE_MUL: r = a * b; break;
+        case OPCODE_AND: r = a & b; break;
+        case OPCODE_OR: r = a | b; break;
+        case OPCODE_XOR: r = a ^ b; break;
+        case OPCODE_CMP: r = a - b; break;
+        case OPCODE_CML: r = a - insn->imm; break;
+        case OPCODE_MOVC: r = r + insn->imm; break;
+        case OPCODE_JALR: r = r + (g->execute.pc + 4); cond = a + insn->imm; break;
+        case OPCODE_JUMP: cond = a + insn->imm; break;
+        case OPCODE_BZ: cond = VEC(ls->zero_flag, i) == TRUE; break;
+        case OPCODE_BNZ: cond = VEC(ls->zero_flag, i) == FALSE; break;
+        case OPCODE_BP: cond = VEC(ls->positive_flag, i) == TRUE; break;
+        case OPCODE_BNP: cond = VEC(ls->positive_flag, i) == FALSE; break;
+        case OPCODE_BN: cond = VEC(ls->negative_flag, i) == TRUE; break;
+        case OPCODE_BNN: cond = VEC(ls->negative_flag, i) == FALSE; break;
+        case OPCODE_LOAD:
+        case OPCODE_LOADP:
+        {
+            VEC(ex->memory_address, i) = ((a + insn->imm) & m) | (VEC(ex->memory_address, i) & ~m);
+            if (insn->opcode == OPCODE_LOADP)
+            {
+                VEC(ex->rs1_value, i) = ((a + 4) & m) | (a & ~m);
+            }
+            break;
+        }
+        case OPCODE_STORE:
+        case OPCODE_STOREP:
+        {
+            VEC(ex->memory_address, i) = ((b + insn->imm) & m) | (VEC(ex->memory_address, i) & ~m);
+            if (insn->opcode == OPCODE_STOREP)
+            {
+                VEC(ex->rs2_value, i) = ((b + 4) & m) | (b & ~m);
+            }
+            break;
+        }
+        }
+
+        switch (insn->opcode)
+        {
+        case OPCODE_ADD:
+        case OPCODE_ADDL:
+        case OPCODE_SUB:
+        case OPCODE_SUBL:
+        case OPCODE_MUL:
+        case OPCODE_AND:
+        case OPCODE_OR:
+        case OPCODE_XOR:
+        case OPCODE_MOVC:
+        case OPCODE_JALR:
+            VEC(ex->result_buffer, i) = (r & m) | (VEC(ex->result_buffer, i) & ~m);
+            break;
+        }
+
+        VEC(ls->scratch, i) = (insn->info->flags & FLAGS_WRITE) ? r : cond;
+    }
+}
+
+/* Sets the P, Z and N flags of every lane from the results in scratch */
+static void
+set_flags_from_results(APEX_Lockstep *ls, const Lane_Group *g)
+{
+    Lane_Vec r, m, zero;
+    int i;
+
+    FOR_EACH_VEC(g, i)
+    {
+        m = VEC(g->mask, i);
+        r = VEC(ls->scratch, i);
+        zero = r - r;
+        VEC(ls->zero_flag, i) = ((r == zero) & m & TRUE) | (VEC(ls->zero_flag, i) & ~m);
+        VEC(ls->positive_flag, i) = ((r > zero) & m & TRUE) | (VEC(ls->positive_flag, i) & ~m);
+        VEC(ls->negative_flag, i) = ((r < zero) & m & TRUE) | (VEC(ls->negative_flag, i) & ~m);
+    }
+}
+
+/*
+ * Resolves a branch or jump of g from the per-lane outcomes in scratch,
+ * splitting off the lanes that go elsewhere. Returns -1 if out of memory
+ */
+static int
+resolve_branch(APEX_Lockstep *ls, Lane_Group *g)
+{
+    const APEX_Instruction *insn = g->execute.insn;
+    int *other = ls->scratch;
+    Lane_Group *split;
+    int lane, target, taken, differ;
+
+    if (insn->opcode == OPCODE_JUMP || insn->opcode == OPCODE_JALR)
+    {
+        /* Peel off the lanes jumping elsewhere until one target is left */
+        while (TRUE)
+        {
+            target = 0;
+            FOR_EACH_LANE(g, lane)
+            {
+                target = ls->scratch[lane];
+                break;
+            }
+
+            differ = FALSE;
+            FOR_EACH_LANE(g, lane)
+            {
+                differ |= ls->scratch[lane] != target;
+            }
+            if (!differ)
+            {
+                take_branch(g, target);
+                return 0;
+            }
+
+            /* Lanes jumping elsewhere move to a new group, still in the
+             * state before the jump */
+            for (lane = g->lo; lane < g->hi; ++lane)
+            {
+                ls->scratch[ls->width + lane] =
+                    g->mask[lane] && ls->scratch[lane] != target;
+            }
+            split = split_group(ls, g, &ls->scratch[ls->width]);
+            if (!split)
+            {
+                return -1;
+            }
+            take_branch(g, target);
+            g = split;
+        }
+    }
+
+    /* Conditional branch: lanes with the condition set take it */
+    taken = 0;
+    differ = 0;
+    FOR_EACH_LANE(g, lane)
+    {
+        if (other[lane])
+        {
+            taken++;
+        }
+        else
+        {
+            differ++;
+        }
+    }
+    target = g->execute.pc + insn->imm;
+    if (taken && differ)
+    {
+        split = split_group(ls, g, other);
+        if (!split)
+        {
+            return -1;
+        }
+        take_branch(split, target);
+    }
+    else if (taken)
+    {
+        take_branch(g, target);
+    }
+    return 0;
+}
+
+static int
+is_control_transfer(int opcode)
+{
+    switch (opcode)
+    {
+    case OPCODE_BZ:
+    case OPCODE_BNZ:
+    case OPCODE_BP:
+    case OPCODE_BNP:
+    case OPCODE_BN:
+    case OPCODE_BNN:
+    case OPCODE_JUMP:
+    case OPCODE_JALR:
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/* Returns -1 if a branch could not split the group */
+static int
+execute_stage(APEX_Lockstep *ls, Lane_Group *g)
+{
+    const APEX_Opcode_Info *info;
+    int branch = FALSE;
+
+    if (!g->execute.has_insn)
+    {
+        return 0;
+    }
+
+    info = g->execute.insn->info;
+    if (g->execute.cycles_left == info->latency)
+    {
+        execute_lanes(ls, g);
+        if (info->flags & FLAGS_WRITE)
+        {
+            set_flags_from_results(ls, g);
+        }
+        branch = is_control_transfer(g->execute.insn->opcode);
+    }
+    g->execute.cycles_left--;
+
+    if (g->execute.cycles_left == 0)
+    {
+        g->memory = g->execute;
+        copy_lane_latch(&ls->memory, &ls->execute, g);
+        g->execute.has_insn = FALSE;
+    }
+
+    /* Branches resolve last, so lanes split off share everything above */
+    return branch ? resolve_branch(ls, g) : 0;
+}
+
+static void
+memory_stage(APEX_Lockstep *ls, Lane_Group *g)
+{
+    const int *address = ls->memory.memory_address;
+    int lane, addr;
+
+    if (!g->memory.has_insn)
+    {
+        return;
+    }
+
+    /* An address outside data memory reads 0 and writes nothing */
+    switch (g->memory.insn->info->memory)
+    {
+    case MEM_LOAD:
+    {
+        FOR_EACH_LANE(g, lane)
+        {
+            addr = address[lane];
+            ls->memory.result_buffer[lane] =
+                (addr >= 0 && addr < DATA_MEMORY_SIZE)
+                    ? ls->data_memory[addr * ls->width + lane]
+                    : 0;
+        }
+        break;
+    }
+
+    case MEM_STORE:
+    {
+        FOR_EACH_LANE(g, lane)
+        {
+            addr = address[lane];
+            if (addr >= 0 && addr < DATA_MEMORY_SIZE)
+            {
+                ls->data_memory[addr * ls->width + lane] = ls->memory.rs1_value[lane];
+            }
+        }
+        break;
+    }
+    }
+
+    g->writeback = g->memory;
+    copy_lane_latch(&ls->writeback, &ls->memory, g);
+    g->memory.has_insn = FALSE;
+}
+
+/* Returns TRUE when HALT retires in the lanes of g */
+static int
+writeback_stage(APEX_Lockstep *ls, Lane_Group *g)
+{
+    const APEX_Instruction *insn = g->writeback.insn;
+    int i;
+
+    if (!g->writeback.has_insn)
+    {
+        return FALSE;
+    }
+
+    if (insn->info->dst & ROLE_RD)
+    {
+        masked_copy(&ls->regs[insn->rd * ls->width], ls->writeback.result_buffer, g);
+    }
+    if (insn->info->dst & ROLE_RS1)
+    {
+        masked_copy(&ls->regs[insn->rs1 * ls->width], ls->writeback.rs1_value, g);
+    }
+    if (insn->info->dst & ROLE_RS2)
+    {
+        masked_copy(&ls->regs[insn->rs2 * ls->width], ls->writeback.rs2_value, g);
+    }
+    set_destination_registers(g, insn->dst_mask, 0);
+
+    /* Subtracting the mask adds one in the lanes of g */
+    FOR_EACH_VEC(g, i)
+    {
+        VEC(ls->insn_completed, i) -= VEC(g->mask, i);
+    }
+    g->writeback.has_insn = FALSE;
+
+    if (insn->opcode == OPCODE_HALT)
+    {
+        masked_set(ls->halt_clock, ls->clock, g);
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/*
+ * Creates the lanes for running the given program section of filename
+ * under the HAZARD_* policy hazard, each starting like a freshly created
+ * APEX_CPU
+ */
+APEX_Lockstep *
+APEX_lockstep_create(const char *filename, int section, int lanes, int hazard)
+{
+    APEX_Lockstep *ls;
+    Lane_Group *g;
+    Lane_Latch *latches[4];
+    int i;
+
+    if (lanes <= 0 || hazard < 0 || hazard >= NUM_HAZARD_POLICIES)
+    {
+        return NULL;
+    }
+
+    ls = calloc(1, sizeof(APEX_Lockstep));
+    g = calloc(1, sizeof(Lane_Group));
+    if (!ls || !g)
+    {
+        free(ls);
+        free(g);
+        return NULL;
+    }
+
+    ls->lanes = lanes;
+    ls->decode_stage = lockstep_decode_stages[hazard];
+    ls->width = (lanes + LOCKSTEP_WIDTH - 1) / LOCKSTEP_WIDTH * LOCKSTEP_WIDTH;
+    ls->code_memory = create_code_memory(filename, section, &ls->code_memory_size);
+    ls->regs = alloc_lanes(ls, REG_FILE_SIZE);
+    ls->data_memory = alloc_lanes(ls, DATA_MEMORY_SIZE);
+    ls->zero_flag = alloc_lanes(ls, 1);
+    ls->positive_flag = alloc_lanes(ls, 1);
+    ls->negative_flag = alloc_lanes(ls, 1);
+    ls->insn_completed = alloc_lanes(ls, 1);
+    ls->halt_clock = alloc_lanes(ls, 1);
+    ls->scratch = alloc_lanes(ls, 2);
+    g->mask = alloc_lanes(ls, 1);
+
+    latches[0] = &ls->decode;
+    latches[1] = &ls->execute;
+    latches[2] = &ls->memory;
+    latches[3] = &ls->writeback;
+    for (i = 0; i < 4; ++i)
+    {
+        latches[i]->rs1_value = alloc_lanes(ls, 1);
+        latches[i]->rs2_value = alloc_lanes(ls, 1);
+        latches[i]->result_buffer = alloc_lanes(ls, 1);
+        latches[i]->memory_address = alloc_lanes(ls, 1);
+    }
+
+    if (!ls->code_memory || !ls->regs || !ls->data_memory || !ls->zero_flag
+        || !ls->positive_flag || !ls->negative_flag || !ls->insn_completed
+        || !ls->halt_clock || !ls->scratch || !g->mask || !ls->decode.memory_address
+        || !ls->execute.memory_address || !ls->memory.memory_address
+        || !ls->writeback.memory_address || add_group(ls, g) != 0)
+    {
+        free_group(g);
+        APEX_lockstep_free(ls);
+        return NULL;
+    }
+
+    for (i = 0; i < ls->width; ++i)
+    {
+        g->mask[i] = i < lanes ? -1 : 0;
+        ls->halt_clock[i] = -1;
+    }
+    update_span(g, ls->width);
+    g->pc = 4000;
+    g->fetch.has_insn = TRUE;
+    return ls;
+}
+
+/* Sets the registers, flags and data memory of a lane from cpu */
+void
+APEX_lockstep_set_lane(APEX_Lockstep *ls, int lane, const APEX_CPU *cpu)
+{
+    int i;
+
+    for (i = 0; i < REG_FILE_SIZE; ++i)
+    {
+        ls->regs[i * ls->width + lane] = cpu->regs[i];
+    }
+    for (i = 0; i < DATA_MEMORY_SIZE; ++i)
+    {
+        ls->data_memory[i * ls->width + lane] = cpu->data_memory[i];
+    }
+    ls->zero_flag[lane] = cpu->zero_flag;
+    ls->positive_flag[lane] = cpu->positive_flag;
+    ls->negative_flag[lane] = cpu->negative_flag;
+}
+
+/*
+ * Copies the registers, flags, data memory, cycle and instruction count of
+ * a lane to cpu. Returns TRUE if HALT retired in the lane
+ */
+int
+APEX_lockstep_get_lane(const APEX_Lockstep *ls, int lane, APEX_CPU *cpu)
+{
+    int i;
+
+    for (i = 0; i < REG_FILE_SIZE; ++i)
+    {
+        cpu->regs[i] = ls->regs[i * ls->width + lane];
+    }
+    for (i = 0; i < DATA_MEMORY_SIZE; ++i)
+    {
+        cpu->data_memory[i] = ls->data_memory[i * ls->width + lane];
+    }
+    APEX_cpu_index_memory(cpu);
+    cpu->zero_flag = ls->zero_flag[lane];
+    cpu->positive_flag = ls->positive_flag[lane];
+    cpu->negative_flag = ls->negative_flag[lane];
+    cpu->insn_completed = ls->insn_completed[lane];
+    cpu->clock = ls->halt_clock[lane] >= 0 ? ls->halt_clock[lane] : ls->clock;
+    return ls->halt_clock[lane] >= 0;
+}
+
+/*
+ * Simulates all lanes until HALT retires in each or the clock reaches
+ * max_cycles, cycle by cycle as APEX_cpu_step does.
+ * Returns the number of lanes halted, or -1 if out of memory
+ */
+int
+APEX_lockstep_run(APEX_Lockstep *ls, int max_cycles)
+{
+    Lane_Group *g;
+    int count, first_new, i, k, lane;
+    int halted = 0;
+
+    while (ls->num_groups > 0 && ls->clock < max_cycles)
+    {
+        count = ls->num_groups;
+        for (i = 0; i < count; ++i)
+        {
+            g = ls->groups[i];
+            if (writeback_stage(ls, g))
+            {
+                g->halted = TRUE;
+                continue;
+            }
+
+            memory_stage(ls, g);
+            first_new = ls->num_groups;
+            if (execute_stage(ls, g) != 0)
+            {
+                return -1;
+            }
+
+            /* Lanes split off by a branch still decode and fetch this cycle */
+            ls->decode_stage(ls, g);
+            fetch_stage(ls, g);
+            for (k = first_new; k < ls->num_groups; ++k)
+            {
+                ls->decode_stage(ls, ls->groups[k]);
+                fetch_stage(ls, ls->groups[k]);
+            }
+        }
+
+        /* Drop the groups that retired HALT this cycle */
+        for (i = 0; i < ls->num_groups;)
+        {
+            g = ls->groups[i];
+            if (g->halted)
+            {
+                free_group(g);
+                ls->groups[i] = ls->groups[--ls->num_groups];
+            }
+            else
+            {
+                ++i;
+            }
+        }
+
+        if (ls->num_groups > 1)
+        {
+            merge_groups(ls);
+        }
+        ls->clock++;
+    }
+
+    for (lane = 0; lane < ls->lanes; ++lane)
+    {
+        halted += ls->halt_clock[lane] >= 0;
+    }
+    return halted;
+}
+
+/* Largest number of groups the lanes were split into */
+int
+APEX_lockstep_peak_groups(const APEX_Lockstep *ls)
+{
+    return ls->peak_groups;
+}
+
+void
+APEX_lockstep_free(APEX_Lockstep *ls)
+{
+    Lane_Latch *latches[4] = {&ls->decode, &ls->execute, &ls->memory, &ls->writeback};
+    int i;
+
+    for (i = 0; i < ls->num_groups; ++i)
+    {
+        free_group(ls->groups[i]);
+    }
+    for (i = 0; i < 4; ++i)
+    {
+        free(latches[i]->rs1_value);
+        free(latches[i]->rs2_value);
+        free(latches[i]->result_buffer);
+        free(latches[i]->memory_address);
+    }
+    free(ls->groups);
+    free(ls->code_memory);
+    free(ls->regs);
+    free(ls->data_memory);
+    free(ls->zero_flag);
+    free(ls->positive_flag);
+    free(ls->negative_flag);
+    free(ls->insn_completed);
+    free(ls->halt_clock);
+    free(ls->scratch);
+    free(ls);
+}
@@ -0,0 +1,269 @@
+/*
+ * apex_log.c
+ * Contains the asynchronous log sink for the text output of a simulation.
+ * The simulation thread prints to the sink's stream as usual; the stream
+ * formats into a LOG_BUFFER_SIZE buffer and each full buffer is handed to
+ * a writer thread through a single-producer single-consumer queue of
+ * LOG_QUEUE_DEPTH buffers, so the simulation only waits for the output
+ * device when the writer falls the whole queue behind.
+ *
+ * On SIGINT, SIGTERM or SIGHUP the writer takes the stream from the
+ * simulation, writes out everything printed so far and lets the signal
+ * terminate the process.
+ */
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "apex_cpu.h"
+#include "apex_macros.h"
+
+/* Signals after which the output is written out before terminating */
+static const int flushed_signals[] = {SIGINT, SIGTERM, SIGHUP};
+
+#define NUM_FLUSHED_SIGNALS (sizeof(flushed_signals) / sizeof(flushed_signals[0]))
+
+_Static_assert((LOG_QUEUE_DEPTH & (LOG_QUEUE_DEPTH - 1)) == 0,
+               "LOG_QUEUE_DEPTH should be a power of two");
+
+/* Buffer handed to the writer */
+typedef struct Log_Buffer
+{
+    char data[LOG_BUFFER_SIZE];
+    size_t len;
+} Log_Buffer;
+
+struct APEX_Log
+{
+    Log_Buffer *queue;        /* LOG_QUEUE_DEPTH buffers */
+    unsigned int head;        /* Next buffer filled, advanced by the simulation */
+    unsigned int tail;        /* Next buffer written, advanced by the writer */
+    int done;                 /* The stream is closed */
+    int failed;               /* A write to target failed */
+    FILE *stream;             /* What the simulation prints to */
+    FILE *target;
+    pthread_t writer;
+    struct sigaction saved[NUM_FLUSHED_SIGNALS]; /* Handlers before the sink */
+};
+
+/* Signal waiting to be handled by the writer, 0 if none */
+static volatile sig_atomic_t pending_signal;
+
+static void
+note_signal(int sig)
+{
+    pending_signal = sig;
+}
+
+/* Writes the queued buffers up to head to the target */
+static void
+write_queued(APEX_Log *log, unsigned int head)
+{
+    Log_Buffer *buffer;
+
+    while (log->tail != head)
+    {
+        buffer = &log->queue[log->tail & (LOG_QUEUE_DEPTH - 1)];
+        if (fwrite(buffer->data, 1, buffer->len, log->target) != buffer->len)
+        {
+            log->failed = TRUE;
+        }
+        __atomic_store_n(&log->tail, log->tail + 1, __ATOMIC_RELEASE);
+    }
+}
+
+/*
+ * Stream write function, called with the stream locked whenever its
+ * buffer fills or is flushed. Waits while every buffer of the queue is
+ * still to be written
+ */
+static ssize_t
+queue_output(void *cookie, const char *data, size_t size)
+{
+    APEX_Log *log = cookie;
+    struct timespec pause = {0, 10000};
+    Log_Buffer *buffer;
+    size_t left = size;
+    size_t len;
+
+    while (left > 0)
+    {
+        while (log->head - __atomic_load_n(&log->tail, __ATOMIC_ACQUIRE) == LOG_QUEUE_DEPTH)
+        {
+            nanosleep(&pause, NULL);
+        }
+
+        len = left < LOG_BUFFER_SIZE ? left : LOG_BUFFER_SIZE;
+        buffer = &log->queue[log->head & (LOG_QUEUE_DEPTH - 1)];
+        memcpy(buffer->data, data, len);
+        buffer->len = len;
+        __atomic_store_n(&log->head, log->head + 1, __ATOMIC_RELEASE);
+
+        data += len;
+        left -= len;
+    }
+    return size;
+}
+
+/* Takes the stream from the simulation, writes out all of its output and
+ * terminates the process with sig */
+static void
+flush_on_signal(APEX_Log *log, int sig)
+{
+    struct timespec wait = {0, 10000};
+
+    /* The simulation may hold the stream while it waits for a free buffer */
+    while (ftrylockfile(log->stream) != 0)
+    {
+        write_queued(log, __atomic_load_n(&log->head, __ATOMIC_ACQUIRE));
+        nanosleep(&wait, NULL);
+    }
+
+    fflush(log->stream);
+    write_queued(log, __atomic_load_n(&log->head, __ATOMIC_ACQUIRE));
+    fflush(log->target);
+
+    /* Delivered to the simulation thread, the writer blocks it */
+    signal(sig, SIG_DFL);
+    kill(getpid(), sig);
+    pause();
+}
+
+static void *
+log_writer(void *arg)
+{
+    APEX_Log *log = arg;
+    struct timespec pause = {0, 100000};
+    unsigned int head;
+    int done;
+
+    for (;;)
+    {
+        if (pending_signal)
+        {
+            flush_on_signal(log, pending_signal);
+        }
+
+        /* done is read first, so every buffer queued before it is seen */
+        done = __atomic_load_n(&log->done, __ATOMIC_ACQUIRE);
+        head = __atomic_load_n(&log->head, __ATOMIC_ACQUIRE);
+        if (head != log->tail)
+        {
+            write_queued(log, head);
+        }
+        else if (done)
+        {
+            break;
+        }
+        else
+        {
+            /* Idle: let the output appear while the simulation runs */
+            fflush(log->target);
+            nanosleep(&pause, NULL);
+        }
+    }
+
+    if (fflush(log->target) != 0)
+    {
+        log->failed = TRUE;
+    }
+    return NULL;
+}
+
+/*
+ * Creates a sink writing to target in the background, see APEX_log_stream.
+ * Returns NULL if it can not be started
+ */
+APEX_Log *
+APEX_log_open(FILE *target)
+{
+    cookie_io_functions_t io = {NULL, queue_output, NULL, NULL};
+    struct sigaction action;
+    sigset_t blocked, previous;
+    APEX_Log *log;
+    size_t i;
+    int started;
+
+    log = calloc(1, sizeof(APEX_Log));
+    if (!log)
+    {
+        return NULL;
+    }
+    log->target = target;
+    log->queue = malloc(LOG_QUEUE_DEPTH * sizeof(Log_Buffer));
+    log->stream = fopencookie(log, "w", io);
+    if (!log->queue || !log->stream
+        || setvbuf(log->stream, NULL, _IOFBF, LOG_BUFFER_SIZE) != 0)
+    {
+        goto fail;
+    }
+
+    /* The signals are taken by the simulation thread, never the writer,
+     * so a write of the writer is not interrupted */
+    sigemptyset(&blocked);
+    for (i = 0; i < NUM_FLUSHED_SIGNALS; ++i)
+    {
+        sigaddset(&blocked, flushed_signals[i]);
+    }
+    pthread_sigmask(SIG_BLOCK, &blocked, &previous);
+    started = pthread_create(&log->writer, NULL, log_writer, log) == 0;
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+
+    if (started)
+    {
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = note_signal;
+        sigemptyset(&action.sa_mask);
+        for (i = 0; i < NUM_FLUSHED_SIGNALS; ++i)
+        {
+            sigaction(flushed_signals[i], &action, &log->saved[i]);
+        }
+        return log;
+    }
+
+fail:
+    if (log->stream)
+    {
+        fclose(log->stream);
+    }
+    free(log->queue);
+    free(log);
+    return NULL;
+}
+
+/* Stream to print the simulation output to */
+FILE *
+APEX_log_stream(APEX_Log *log)
+{
+    return log->stream;
+}
+
+/*
+ * Writes out everything printed to the stream, stops the writer and closes
+ * the sink. Returns 0 on success, -1 if the output could not be written
+ */
+int
+APEX_log_close(APEX_Log *log)
+{
+    size_t i;
+    int failed;
+
+    for (i = 0; i < NUM_FLUSHED_SIGNALS; ++i)
+    {
+        sigaction(flushed_signals[i], &log->saved[i], NULL);
+    }
+
+    fclose(log->stream);
+    __atomic_store_n(&log->done, TRUE, __ATOMIC_RELEASE);
+    pthread_join(log->writer, NULL);
+
+    failed = log->failed;
+    free(log->queue);
+    free(log);
+    return failed ? -1 : 0;
+}
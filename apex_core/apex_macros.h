@@ -0,0 +1,199 @@
+/*
+ * apex_macros.h
+ * Contains APEX cpu pipeline macros
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#ifndef _MACROS_H_
+#define _MACROS_H_
+
+#define FALSE 0x0
+#define TRUE 0x1
+
+/* Integers */
+#define DATA_MEMORY_SIZE 4096
+
+/* Size of integer register file */
+#define REG_FILE_SIZE 32
+
+/* Longest program name kept from a ---TC n--- section header */
+#define SECTION_NAME_SIZE 32
+
+/* Numeric OPCODE identifiers for instructions */
+#define OPCODE_ADD 0x0
+#define OPCODE_SUB 0x1
+#define OPCODE_MUL 0x2
+#define OPCODE_DIV 0x3
+#define OPCODE_AND 0x4
+#define OPCODE_OR 0x5
+#define OPCODE_XOR 0x6
+#define OPCODE_MOVC 0x7
+#define OPCODE_LOAD 0x8
+#define OPCODE_STORE 0x9
+#define OPCODE_BZ 0xa
+#define OPCODE_BNZ 0xb
+#define OPCODE_HALT 0xc
+#define OPCODE_BP 0xe
+#define OPCODE_BNP 0xf
+#define OPCODE_BN 0x11
+#define OPCODE_BNN 0x12
+#define OPCODE_CML 0x13
+#define OPCODE_CMP 0x14
+#define OPCODE_NOP 0x15
+#define OPCODE_LOADP 0x16
+#define OPCODE_STOREP 0x17
+#define OPCODE_SUBL 0x18
+#define OPCODE_ADDL 0x19
+#define OPCODE_JUMP 0x21
+#define OPCODE_JALR 0x22
+
+/* Size of the opcode descriptor table */
+#define NUM_OPCODES 0x23
+
+/* Operand kinds in assembly order, see APEX_Opcode_Info */
+#define OPERAND_NONE 0x0
+#define OPERAND_RD 0x1
+#define OPERAND_RS1 0x2
+#define OPERAND_RS2 0x3
+#define OPERAND_IMM 0x4
+
+/* Register roles of an instruction */
+#define ROLE_RD 0x1
+#define ROLE_RS1 0x2
+#define ROLE_RS2 0x4
+
+/* Effect of an instruction on the P/Z/N flags */
+#define FLAGS_NONE 0x0
+#define FLAGS_WRITE 0x1
+#define FLAGS_READ 0x2
+
+/* Data memory access in the memory stage */
+#define MEM_NONE 0x0
+#define MEM_LOAD 0x1
+#define MEM_STORE 0x2
+
+/* Hazard resolution policies of the pipeline, see APEX_cpu_set_hazard */
+#define HAZARD_STALLING 0x0
+#define HAZARD_FORWARDING 0x1
+#define HAZARD_BYPASS 0x2
+#define NUM_HAZARD_POLICIES 0x3
+
+/* Policy of a newly created CPU, chosen with `make HAZARD=<policy>` */
+#ifndef DEFAULT_HAZARD_POLICY
+#define DEFAULT_HAZARD_POLICY HAZARD_FORWARDING
+#endif
+
+/* Per-cycle output of APEX_cpu_run, see the log option */
+#define LOG_QUIET 0x0          /* Only the final summary */
+#define LOG_STATE 0x1          /* Register file, data memory and flags after each cycle */
+#define LOG_PIPELINE 0x2       /* Also the code memory, cycle numbers and every stage */
+
+/* Log level of a CPU created with an output stream */
+#ifndef DEFAULT_LOG_LEVEL
+#define DEFAULT_LOG_LEVEL LOG_PIPELINE
+#endif
+
+/* Outcome of a stretch of cycles in APEX_cpu_run */
+#define RUN_CONTINUE 0x0
+#define RUN_HALTED 0x1
+#define RUN_STOPPED 0x2
+
+/* Pipeline stages, in the order they are printed */
+#define STAGE_FETCH 0x0
+#define STAGE_DECODE 0x1
+#define STAGE_EXECUTE 0x2
+#define STAGE_MEMORY 0x3
+#define STAGE_WRITEBACK 0x4
+#define NUM_STAGES 0x5
+
+/* Why the instruction in decode was held back */
+#define STALL_NONE 0x0
+#define STALL_EXECUTE_BUSY 0x1
+#define STALL_OPERANDS 0x2
+
+/* Cause a decode stall cycle is counted under, see APEX_Counters */
+#define STALL_CAUSE_RAW 0x0          /* A source is written by an ALU instruction in flight */
+#define STALL_CAUSE_LOAD_USE 0x1     /* A source is loaded by an instruction in flight */
+#define STALL_CAUSE_FLAGS 0x2        /* A branch waits for the flag-setting instruction in execute */
+#define STALL_CAUSE_EXECUTE_BUSY 0x3 /* Sources ready, the functional unit is occupied */
+#define NUM_STALL_CAUSES 0x4
+
+/* Binary trace event types, see apex_trace.c */
+#define TRACE_CYCLE 0x1
+#define TRACE_STAGE 0x2
+#define TRACE_REG 0x3
+#define TRACE_MEM 0x4
+#define TRACE_FLAGS 0x5
+#define TRACE_IDLE 0x6
+#define TRACE_HALT 0x7
+
+/* TRACE_STAGE forwarded bits and TRACE_FLAGS value bits */
+#define TRACE_FORWARD_EX 0x1
+#define TRACE_FORWARD_MEM 0x2
+#define TRACE_FLAG_ZERO 0x1
+#define TRACE_FLAG_POSITIVE 0x2
+#define TRACE_FLAG_NEGATIVE 0x4
+
+/* Trace file identification */
+#define TRACE_MAGIC "APEXTRCE"
+#define TRACE_VERSION 1
+
+/* Program image identification, see apex_as.c */
+#define BINARY_MAGIC "APEXBIN"
+#define BINARY_VERSION 1
+
+/* Events buffered between the simulation and the trace writer thread,
+ * a power of two */
+#define TRACE_RING_SIZE 65536
+
+/* Text output buffers of the asynchronous log, see apex_log.c: bytes per
+ * buffer, and buffers queued for the writer thread, a power of two */
+#define LOG_BUFFER_SIZE 65536
+#define LOG_QUEUE_DEPTH 8
+
+/* Dispatch of the functional core: 1 for threaded dispatch through
+ * pre-resolved handler addresses (needs GCC/Clang labels as values),
+ * 0 for a switch. Build with `make DISPATCH=switch` to force the switch */
+#ifndef ENABLE_THREADED_DISPATCH
+#if defined(__GNUC__)
+#define ENABLE_THREADED_DISPATCH 1
+#else
+#define ENABLE_THREADED_DISPATCH 0
+#endif
+#endif
+
+/* Binary translation of the functional model to x86-64, see apex_dbt.c.
+ * Disable with `make DBT=0` */
+#ifndef ENABLE_DBT
+#if defined(__x86_64__) && defined(__unix__)
+#define ENABLE_DBT 1
+#else
+#define ENABLE_DBT 0
+#endif
+#endif
+
+/* Set this flag to 1 (or build with `make LATCH_STATS=1`) to report latch
+ * sizes and the bytes copied between latches */
+#ifndef ENABLE_LATCH_STATS
+#define ENABLE_LATCH_STATS 0
+#endif
+
+/* Set this flag to 0 to simulate every cycle one by one, including the
+ * cycles in which the pipeline can not change (see idle_cycles) */
+#ifndef ENABLE_IDLE_SKIP
+#define ENABLE_IDLE_SKIP 1
+#endif
+
+/* 32-bit lanes per vector in the lockstep engine: 8 when built for AVX2
+ * (make SIMD=avx2), otherwise 4, one SSE register */
+#ifndef LOCKSTEP_WIDTH
+#ifdef __AVX2__
+#define LOCKSTEP_WIDTH 8
+#else
+#define LOCKSTEP_WIDTH 4
+#endif
+#endif
+
+#endif
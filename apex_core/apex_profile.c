@@ -0,0 +1,155 @@
+/*
+ * apex_profile.c
+ * Contains the per-instruction profile of the pipeline: with profiling
+ * enabled, the cycle loop counts into one APEX_Profile_Entry per code
+ * memory entry, a flat array indexed like code memory, so profiling costs
+ * a few increments per cycle and can be left on.
+ *
+ * The report is the program as written in the input file, each
+ * instruction line annotated with its counters:
+ *
+ *   ;  cycles  fetch decode   exec    mem     wb  stall%   raw  load flags  busy caused
+ *          10      2      2      2      2      2    0.0%     0     0     0     0      2 | LOADP R4,R1,#4
+ *          12      2      4      2      2      2    8.0%     0     2     0     0      0 | EX-OR R4,R4,R3
+ *
+ * cycles is the sum of the stage columns; wb is also the number of times
+ * the instruction retired. stall% is the share of all cycles of the run
+ * the instruction was held in decode, split into raw, load(-use), flags
+ * and (execute) busy stall cycles as in APEX_Counters. caused counts the
+ * decode stall cycles of other instructions waiting on this one.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_cpu.h"
+#include "apex_macros.h"
+
+/* Width of the annotation before the source text */
+#define PROFILE_COLUMNS_WIDTH 84
+
+/*
+ * Starts counting the cycles of cpu into a zeroed profile, replacing any
+ * profile it had; quiet cycles switch to the profiling cycle function of
+ * its hazard policy. Returns -1 if it can not be allocated
+ */
+int
+APEX_cpu_enable_profile(APEX_CPU *cpu)
+{
+    /* The sentinel entry collects fetches past the end of the program */
+    free(cpu->profile);
+    cpu->profile = calloc(cpu->code_memory_size + 1, sizeof(APEX_Profile_Entry));
+    APEX_cpu_set_hazard(cpu, cpu->hazard);
+    return cpu->profile ? 0 : -1;
+}
+
+static void
+write_profile_entry(FILE *out, const APEX_Profile_Entry *entry, int clock)
+{
+    long cycles = 0;
+    long stalls = 0;
+    int i;
+
+    for (i = 0; i < NUM_STAGES; ++i)
+    {
+        cycles += entry->stage_cycles[i];
+    }
+    for (i = 0; i < NUM_STALL_CAUSES; ++i)
+    {
+        stalls += entry->stalls[i];
+    }
+
+    fprintf(out, " %8ld", cycles);
+    for (i = 0; i < NUM_STAGES; ++i)
+    {
+        fprintf(out, " %6ld", entry->stage_cycles[i]);
+    }
+    fprintf(out, " %6.1f%%", clock ? 100.0 * stalls / clock : 0.0);
+    for (i = 0; i < NUM_STALL_CAUSES; ++i)
+    {
+        fprintf(out, " %5ld", entry->stalls[i]);
+    }
+    fprintf(out, " %6ld | ", entry->caused);
+}
+
+/*
+ * Writes the profile of cpu, loaded from the given program section of its
+ * input file, as the annotated program listing described above.
+ * Returns 0 on success, -1 if cpu is not profiled, the input file no
+ * longer matches its code memory or out could not be written
+ */
+int
+APEX_cpu_write_profile(const APEX_CPU *cpu, int section, FILE *out)
+{
+    const APEX_Profile_Entry *past_end;
+    FILE *fp;
+    size_t len = 0;
+    char *line = NULL;
+    int *lines;
+    int size, i;
+    int line_num = 0;
+    int next = 0;
+
+    if (!cpu->profile)
+    {
+        return -1;
+    }
+
+    lines = get_code_lines(cpu->filename, section, &size);
+    fp = fopen(cpu->filename, "r");
+    if (!lines || size != cpu->code_memory_size || !fp)
+    {
+        free(lines);
+        if (fp)
+        {
+            fclose(fp);
+        }
+        return -1;
+    }
+
+    fprintf(out, "; APEX profile of %s, %s pipeline: %d cycles, %d instructions, "
+                 "%d stall cycles\n;\n",
+            cpu->filename, APEX_hazard_name(cpu->hazard), cpu->clock, cpu->insn_completed,
+            cpu->stall_cycles);
+    fprintf(out, "; %7s %6s %6s %6s %6s %6s %7s %5s %5s %5s %5s %6s\n", "cycles", "fetch",
+            "decode", "exec", "mem", "wb", "stall%", "raw", "load", "flags", "busy", "caused");
+
+    /* Lines between the first and last instruction of the section, blank
+     * lines and comments left unannotated */
+    while (next < size && getline(&line, &len, fp) != -1)
+    {
+        line_num++;
+        if (line_num < lines[0])
+        {
+            continue;
+        }
+
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line_num == lines[next])
+        {
+            write_profile_entry(out, &cpu->profile[next], cpu->clock);
+            next++;
+        }
+        else
+        {
+            fprintf(out, "%*s| ", PROFILE_COLUMNS_WIDTH, "");
+        }
+        fprintf(out, "%s\n", line);
+    }
+
+    past_end = &cpu->profile[cpu->code_memory_size];
+    for (i = 0; i < NUM_STAGES; ++i)
+    {
+        if (past_end->stage_cycles[i])
+        {
+            write_profile_entry(out, past_end, cpu->clock);
+            fprintf(out, "(past the end of the program)\n");
+            break;
+        }
+    }
+
+    free(line);
+    free(lines);
+    fclose(fp);
+    return ferror(out) ? -1 : 0;
+}
@@ -0,0 +1,79 @@
+/*
+ * apex_sampling.c
+ * Contains the sampled simulation mode: the program runs in the functional
+ * model and the detailed pipeline is only used for short periodic windows,
+ * whose CPI is measured and extrapolated to the whole run
+ */
+#include <math.h>
+#include <string.h>
+
+#include "apex_cpu.h"
+#include "apex_macros.h"
+
+/*
+ * Sampled simulation. Repeats until HALT retires:
+ *
+ *  - execute period instructions functionally
+ *  - run warmup instructions in the pipeline to refill it (not measured)
+ *  - run unit instructions in the pipeline and record their CPI
+ *  - drain the pipeline and hand the state back to the functional model
+ *
+ * The estimated cycle count is the mean unit CPI times the number of
+ * instructions retired by both models. A unit cut short by HALT is not
+ * recorded, since its CPI includes the final pipeline drain.
+ */
+void
+APEX_cpu_run_sampled(APEX_CPU *cpu, long period, long unit, long warmup,
+                     APEX_Sample_Stats *stats)
+{
+    double mean = 0.0;
+    double m2 = 0.0;
+    int halted = FALSE;
+
+    memset(stats, 0, sizeof(*stats));
+
+    while (!halted)
+    {
+        int start_clock;
+        double cpi, delta;
+
+        if (APEX_cpu_fast_forward(cpu, period, -1))
+        {
+            break;
+        }
+
+        /* Fast-forward ran off the end of code memory */
+        if (cpu->pc < 4000 || cpu->pc >= 4000 + 4 * cpu->code_memory_size)
+        {
+            break;
+        }
+
+        if (APEX_cpu_step_insns(cpu, warmup))
+        {
+            break;
+        }
+
+        start_clock = cpu->clock;
+        halted = APEX_cpu_step_insns(cpu, unit);
+        if (!halted)
+        {
+            /* Welford's running mean and variance */
+            cpi = (double)(cpu->clock - start_clock) / unit;
+            stats->samples++;
+            delta = cpi - mean;
+            mean += delta / stats->samples;
+            m2 += delta * (cpi - mean);
+
+            halted = APEX_cpu_drain(cpu);
+        }
+    }
+
+    stats->insns = cpu->functional_insns + cpu->insn_completed;
+    stats->cpi_mean = mean;
+    if (stats->samples > 1)
+    {
+        stats->cpi_stddev = sqrt(m2 / (stats->samples - 1));
+        stats->cpi_ci95 = 1.96 * stats->cpi_stddev / sqrt(stats->samples);
+    }
+    stats->est_cycles = mean * stats->insns;
+}
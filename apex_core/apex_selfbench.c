@@ -0,0 +1,233 @@
+/*
+ * apex_selfbench.c
+ * Contains the host throughput benchmark of the simulator itself: every
+ * program of a batch is simulated by APEX_cpu_run under each hazard
+ * policy in SELFBENCH_POLICIES, once quiet and once printing every cycle,
+ * and the host time per simulated cycle and per retired instruction is
+ * written as CSV, one row per program, policy and output:
+ *
+ *   program,pipeline,output,trials,cycles,instructions,
+ *   ns_per_cycle_median,ns_per_cycle_p10,ns_per_cycle_p90,
+ *   ns_per_insn_median,ns_per_insn_p10,ns_per_insn_p90
+ *
+ * A trial simulates the program from its loaded state as many times as it
+ * takes to fill SELFBENCH_TRIAL_NS of simulation; only APEX_cpu_run is
+ * timed, not copying the CPU. The first warmup trials of every row are
+ * not counted. Printed output goes to /dev/null, so the verbose rows
+ * measure formatting the text, not the device it is written to.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "apex_cpu.h"
+#include "apex_macros.h"
+
+/* Simulation time of one trial */
+#define SELFBENCH_TRIAL_NS 10000000.0
+
+static const int selfbench_policies[] = {HAZARD_STALLING, HAZARD_FORWARDING};
+
+#define SELFBENCH_POLICIES (sizeof(selfbench_policies) / sizeof(selfbench_policies[0]))
+
+/* Output of a row: log level and name */
+static const struct
+{
+    int log_level;
+    const char *name;
+} selfbench_outputs[] = {
+    {LOG_QUIET, "quiet"},
+    {LOG_PIPELINE, "verbose"},
+};
+
+#define SELFBENCH_OUTPUTS (sizeof(selfbench_outputs) / sizeof(selfbench_outputs[0]))
+
+/* Timing of one row */
+typedef struct Selfbench_Row
+{
+    int cycles;            /* Of one simulation */
+    int insns;
+    double *ns_per_cycle;  /* Per trial */
+    double *ns_per_insn;
+} Selfbench_Row;
+
+static double
+host_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int
+compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+/* Nearest-rank p-th percentile of the n sorted values */
+static double
+percentile(const double *sorted, int n, double p)
+{
+    int rank = (int)ceil(p / 100.0 * n);
+
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+/*
+ * Runs warmup + trials trials of the program loaded in template under
+ * policy with the given output, for at most max_cycles cycles each
+ * simulation, and fills row. Returns -1 if out of memory
+ */
+static int
+time_row(const APEX_CPU *template, int policy, int output, FILE *sink, int trials,
+         int warmup, int max_cycles, Selfbench_Row *row)
+{
+    APEX_CPU *cpu = malloc(sizeof(APEX_CPU));
+    double start, ns;
+    long cycles, insns;
+    int t;
+
+    if (!cpu)
+    {
+        return -1;
+    }
+
+    for (t = -warmup; t < trials; ++t)
+    {
+        ns = 0;
+        cycles = 0;
+        insns = 0;
+        do
+        {
+            /* The copy shares code memory with the template */
+            *cpu = *template;
+            APEX_cpu_set_hazard(cpu, policy);
+            cpu->log_level = selfbench_outputs[output].log_level;
+            cpu->out = cpu->log_level == LOG_QUIET ? NULL : sink;
+
+            start = host_ns();
+            APEX_cpu_run(cpu, max_cycles);
+            ns += host_ns() - start;
+
+            cycles += cpu->clock;
+            insns += cpu->insn_completed;
+        } while (ns < SELFBENCH_TRIAL_NS);
+
+        if (t >= 0)
+        {
+            row->ns_per_cycle[t] = cycles ? ns / cycles : 0.0;
+            row->ns_per_insn[t] = insns ? ns / insns : 0.0;
+        }
+    }
+
+    row->cycles = cpu->clock;
+    row->insns = cpu->insn_completed;
+    free(cpu);
+    return 0;
+}
+
+static void
+write_row(FILE *out, const char *program, int policy, int output, int trials,
+          Selfbench_Row *row)
+{
+    qsort(row->ns_per_cycle, trials, sizeof(double), compare_double);
+    qsort(row->ns_per_insn, trials, sizeof(double), compare_double);
+
+    fprintf(out, "%s,%s,%s,%d,%d,%d,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f\n", program,
+            APEX_hazard_name(policy), selfbench_outputs[output].name, trials, row->cycles,
+            row->insns, percentile(row->ns_per_cycle, trials, 50),
+            percentile(row->ns_per_cycle, trials, 10), percentile(row->ns_per_cycle, trials, 90),
+            percentile(row->ns_per_insn, trials, 50), percentile(row->ns_per_insn, trials, 10),
+            percentile(row->ns_per_insn, trials, 90));
+    fflush(out);
+}
+
+/*
+ * Benchmarks the simulator on every program listed in source (see
+ * APEX_batch_collect) on one host thread, with warmup trials followed by
+ * trials counted ones per row and each simulation at most max_cycles
+ * cycles, and writes the CSV described above to out.
+ *
+ * Returns the number of programs that could not be loaded, or -1 if source
+ * can not be read or trials is not positive
+ */
+int
+APEX_selfbench_run(const char *source, int trials, int warmup, int max_cycles, FILE *out)
+{
+    APEX_Program *programs;
+    APEX_CPU *template;
+    Selfbench_Row row;
+    FILE *sink;
+    char program[256];
+    size_t policy, output;
+    int count, i;
+    int failed = 0;
+
+    if (trials <= 0 || warmup < 0)
+    {
+        return -1;
+    }
+    count = APEX_batch_collect(source, &programs);
+    if (count < 0)
+    {
+        return -1;
+    }
+
+    sink = fopen("/dev/null", "w");
+    row.ns_per_cycle = calloc(trials, sizeof(double));
+    row.ns_per_insn = calloc(trials, sizeof(double));
+    if (!sink || !row.ns_per_cycle || !row.ns_per_insn)
+    {
+        failed = -1;
+        goto out;
+    }
+
+    fprintf(out, "program,pipeline,output,trials,cycles,instructions,"
+                 "ns_per_cycle_median,ns_per_cycle_p10,ns_per_cycle_p90,"
+                 "ns_per_insn_median,ns_per_insn_p10,ns_per_insn_p90\n");
+
+    for (i = 0; i < count; ++i)
+    {
+        APEX_program_label(&programs[i], program, sizeof(program));
+        template = APEX_cpu_create(programs[i].path, programs[i].section, NULL);
+        if (!template)
+        {
+            fprintf(stderr, "APEX_Error: Unable to load %s\n", program);
+            failed++;
+            continue;
+        }
+
+        for (policy = 0; policy < SELFBENCH_POLICIES; ++policy)
+        {
+            for (output = 0; output < SELFBENCH_OUTPUTS; ++output)
+            {
+                if (time_row(template, selfbench_policies[policy], output, sink, trials,
+                             warmup, max_cycles, &row) != 0)
+                {
+                    APEX_cpu_stop(template);
+                    failed = -1;
+                    goto out;
+                }
+                write_row(out, program, selfbench_policies[policy], output, trials, &row);
+            }
+        }
+        APEX_cpu_stop(template);
+    }
+
+out:
+    if (sink)
+    {
+        fclose(sink);
+    }
+    free(row.ns_per_cycle);
+    free(row.ns_per_insn);
+    APEX_batch_free(programs, count);
+    return failed;
+}
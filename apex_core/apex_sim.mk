@@ -0,0 +1,104 @@
+#
+# apex_sim.mk
+# Builds the simulator from the sources of this directory into the
+# directory of the including Makefile, see Part_1_Stalling and
+# Part_2_Forwarding. The including Makefile sets HAZARD.
+#
+# Author:
+# Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+# State University of New York at Binghamton
+
+# Directory of the sources, scripts and benchmarks
+CORE:=$(dir $(lastword $(MAKEFILE_LIST)))
+vpath %.c $(CORE)
+
+# Enables debug messages while compiling
+COMPILE_DEBUG=@
+VERSION=2.0
+
+# Compile and Link flags, libraries
+CC=$(CROSS_PREFIX)gcc
+CFLAGS= -g -Wall -O0 -pthread -DVERSION=$(VERSION) -I$(CORE)
+
+# Report latch sizes and per-cycle latch copy bytes: make LATCH_STATS=1
+ifeq ($(LATCH_STATS),1)
+CFLAGS+= -DENABLE_LATCH_STATS=1
+endif
+# Use a switch instead of threaded dispatch in the functional core: make DISPATCH=switch
+ifeq ($(DISPATCH),switch)
+CFLAGS+= -DENABLE_THREADED_DISPATCH=0
+endif
+# Leave out the x86-64 binary translator: make DBT=0
+ifeq ($(DBT),0)
+CFLAGS+= -DENABLE_DBT=0
+endif
+# Build the lockstep engine's vector kernels for AVX2 instead of SSE: make SIMD=avx2
+ifeq ($(SIMD),avx2)
+CFLAGS+= -mavx2
+endif
+# Hazard policy of a CPU not given `pipeline <policy>`: make HAZARD=stalling|forwarding|bypass
+HAZARD?=forwarding
+ifeq ($(HAZARD),stalling)
+CFLAGS+= -DDEFAULT_HAZARD_POLICY=HAZARD_STALLING
+endif
+ifeq ($(HAZARD),forwarding)
+CFLAGS+= -DDEFAULT_HAZARD_POLICY=HAZARD_FORWARDING
+endif
+ifeq ($(HAZARD),bypass)
+CFLAGS+= -DDEFAULT_HAZARD_POLICY=HAZARD_BYPASS
+endif
+LDFLAGS=
+LIBS= -lm -lpthread
+
+PROGS= apex_sim apex_trace_decode apex-as
+
+all: clean $(PROGS) 
+
+# Add all object files to be linked in sequence
+APEX_OBJS:=file_parser.o apex_cpu.o apex_functional.o apex_dbt.o apex_sampling.o apex_checkpoint.o apex_interval.o apex_batch.o apex_sweep.o apex_lockstep.o apex_trace.o apex_log.o apex_counters.o apex_profile.o apex_selfbench.o main.o
+
+apex_sim: $(APEX_OBJS)
+	$(CC) $(LDFLAGS) -g -o $@ $^ $(LIBS)
+
+# Renders binary traces (apex_sim <input_file> trace <file>) as text
+apex_trace_decode: apex_trace_decode.o $(filter-out main.o,$(APEX_OBJS))
+	$(CC) $(LDFLAGS) -g -o $@ $^ $(LIBS)
+
+# Assembles an input file into a program image (.apexbin) apex_sim loads
+apex-as: apex_as.o $(filter-out main.o,$(APEX_OBJS))
+	$(CC) $(LDFLAGS) -g -o $@ $^ $(LIBS)
+
+# Same simulator with the switch-dispatched functional core, for comparison
+apex_sim_switch: $(filter-out apex_functional.o,$(APEX_OBJS)) apex_functional_switch.o
+	$(CC) $(LDFLAGS) -g -o $@ $^ $(LIBS)
+
+apex_functional_switch.o: apex_functional.c
+	$(COMPILE_DEBUG)$(CC) $(CFLAGS) -DENABLE_THREADED_DISPATCH=0 -c -o $@ $<
+	$(COMPILE_DEBUG)echo "CC $< (switch dispatch)"
+
+# Functional core MIPS, switch vs threaded dispatch, on every test program
+bench-dispatch: apex_sim apex_sim_switch
+	$(CORE)bench_dispatch.sh 100000 test_cases.asm all_tests.asm
+
+# Kernels of bench/: checks cycles and final state, reports host MIPS
+.PHONY: bench
+bench: apex_sim
+	$(CORE)bench/run_bench.sh ./apex_sim
+
+# Parser throughput on a generated program of a million instructions,
+# as text and as a program image
+.PHONY: bench-parse
+bench-parse: apex_sim apex-as
+	$(CORE)bench/run_parse_bench.sh ./apex_sim
+
+# Host time per simulated cycle against bench/selfbench_baseline.csv
+.PHONY: selfbench
+selfbench: apex_sim
+	$(CORE)bench/run_selfbench.sh ./apex_sim selfbench.csv
+
+%.o: %.c
+	$(COMPILE_DEBUG)$(CC) $(CFLAGS) -c -o $@ $<
+	$(COMPILE_DEBUG)echo "CC $<"
+
+clean:
+	rm -f *.o *.d *~ $(PROGS) apex_sim_switch
@@ -0,0 +1,354 @@
+/*
+ * apex_sweep.c
+ * Contains the configuration sweep: every program of a batch is simulated
+ * under every combination of the parameter values in a grid file, on a
+ * pool of host threads, and one CSV row is written per point.
+ *
+ * Grid file, one swept parameter per line, # starts a comment:
+ *
+ *   MUL 1 2 4                execute latency of MUL in cycles
+ *   DIV 1 8 16
+ *   PIPELINE stalling bypass hazard policies, see APEX_hazard_name
+ *
+ * Each program is parsed once; all of its points start from a copy of the
+ * same CPU and share its code memory.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_cpu.h"
+#include "apex_macros.h"
+
+#define SWEEP_MAX_VALUES 64
+
+/* Every opcode latency and the pipeline */
+#define SWEEP_MAX_PARAMS (NUM_OPCODES + 1)
+
+/* Parameter opcode of the PIPELINE line */
+#define SWEEP_PIPELINE NUM_OPCODES
+
+/* Outcome of one point */
+#define SWEEP_HALTED 0x0
+#define SWEEP_TIMEOUT 0x1
+#define SWEEP_LOAD_ERROR 0x2
+
+/* Execute latency of one opcode, or the hazard policy, and the values it
+ * takes */
+typedef struct Sweep_Param
+{
+    char name[16];
+    int opcode;            /* OPCODE_* or SWEEP_PIPELINE */
+    int values[SWEEP_MAX_VALUES]; /* Latencies or HAZARD_* policies */
+    int count;
+} Sweep_Param;
+
+typedef struct Sweep_Result
+{
+    int status;            /* SWEEP_* */
+    int cycles;
+    int insns;
+    int stall_cycles;
+} Sweep_Result;
+
+typedef struct Sweep
+{
+    APEX_Program *programs;
+    int num_programs;
+    APEX_CPU **templates;  /* Freshly loaded CPU per program, NULL if it failed */
+    Sweep_Param params[SWEEP_MAX_PARAMS];
+    int num_params;
+    int hazard;            /* Policy unless the grid has a PIPELINE line */
+    int num_configs;       /* Product of the value counts */
+    Sweep_Result *results; /* [num_programs][num_configs] */
+    int max_cycles;
+} Sweep;
+
+/* Reads the grid file. Returns -1 after reporting the first bad line */
+static int
+read_grid(Sweep *sweep, const char *grid)
+{
+    FILE *fp = fopen(grid, "r");
+    char *line = NULL;
+    size_t len = 0;
+    char *token, *saveptr, *end;
+    Sweep_Param *param;
+    int line_num = 0;
+    int ret = 0;
+    int bad;
+    long value;
+
+    if (!fp)
+    {
+        fprintf(stderr, "APEX_Error: Unable to read grid %s\n", grid);
+        return -1;
+    }
+
+    sweep->num_configs = 1;
+    while (ret == 0 && getline(&line, &len, fp) != -1)
+    {
+        line_num++;
+        line[strcspn(line, "#\r\n")] = '\0';
+        token = strtok_r(line, " \t", &saveptr);
+        if (!token)
+        {
+            continue;
+        }
+
+        if (sweep->num_params == SWEEP_MAX_PARAMS)
+        {
+            fprintf(stderr, "APEX_Error: %s line %d: too many parameters\n", grid, line_num);
+            ret = -1;
+            break;
+        }
+
+        param = &sweep->params[sweep->num_params];
+        if (strcmp(token, "PIPELINE") == 0)
+        {
+            param->opcode = SWEEP_PIPELINE;
+        }
+        else
+        {
+            param->opcode = get_opcode_from_string(token);
+        }
+        if (param->opcode < 0)
+        {
+            fprintf(stderr, "APEX_Error: %s line %d: unknown parameter %s\n", grid, line_num,
+                    token);
+            ret = -1;
+            break;
+        }
+        snprintf(param->name, sizeof(param->name), "%s", token);
+        param->count = 0;
+
+        while ((token = strtok_r(NULL, " \t", &saveptr)) != NULL)
+        {
+            if (param->opcode == SWEEP_PIPELINE)
+            {
+                value = APEX_hazard_from_string(token);
+                bad = value < 0;
+            }
+            else
+            {
+                value = strtol(token, &end, 10);
+                bad = *end || value < 1 || value > 255;
+            }
+            if (bad || param->count == SWEEP_MAX_VALUES)
+            {
+                fprintf(stderr, "APEX_Error: %s line %d: bad %s %s\n", grid, line_num,
+                        param->opcode == SWEEP_PIPELINE ? "pipeline" : "latency", token);
+                ret = -1;
+                break;
+            }
+            param->values[param->count++] = value;
+        }
+        if (ret == 0 && param->count == 0)
+        {
+            fprintf(stderr, "APEX_Error: %s line %d: no values for %s\n", grid, line_num,
+                    param->name);
+            ret = -1;
+        }
+
+        sweep->num_configs *= param->count;
+        sweep->num_params++;
+    }
+
+    free(line);
+    fclose(fp);
+    return ret;
+}
+
+/* Value of parameter param in configuration config, the first parameter
+ * varying fastest */
+static int
+config_value(const Sweep *sweep, int config, int param)
+{
+    int i;
+
+    for (i = 0; i < param; ++i)
+    {
+        config /= sweep->params[i].count;
+    }
+    return sweep->params[param].values[config % sweep->params[param].count];
+}
+
+static void
+load_program(void *arg, int i)
+{
+    Sweep *sweep = arg;
+
+    sweep->templates[i] =
+        APEX_cpu_create(sweep->programs[i].path, sweep->programs[i].section, NULL);
+    if (sweep->templates[i])
+    {
+        APEX_cpu_set_hazard(sweep->templates[i], sweep->hazard);
+    }
+}
+
+static void
+run_point(void *arg, int i)
+{
+    Sweep *sweep = arg;
+    const APEX_CPU *template = sweep->templates[i / sweep->num_configs];
+    Sweep_Result *result = &sweep->results[i];
+    APEX_CPU *cpu;
+    int p;
+
+    result->status = SWEEP_LOAD_ERROR;
+    if (!template || !(cpu = malloc(sizeof(APEX_CPU))))
+    {
+        return;
+    }
+
+    /* The copy shares code memory with the template */
+    *cpu = *template;
+    for (p = 0; p < sweep->num_params; ++p)
+    {
+        if (sweep->params[p].opcode == SWEEP_PIPELINE)
+        {
+            APEX_cpu_set_hazard(cpu, config_value(sweep, i % sweep->num_configs, p));
+        }
+        else
+        {
+            cpu->latency[sweep->params[p].opcode] =
+                config_value(sweep, i % sweep->num_configs, p);
+        }
+    }
+
+    result->status =
+        APEX_cpu_step_until(cpu, sweep->max_cycles) ? SWEEP_HALTED : SWEEP_TIMEOUT;
+
+    result->cycles = cpu->clock;
+    result->insns = cpu->insn_completed;
+    result->stall_cycles = cpu->stall_cycles;
+    free(cpu);
+}
+
+/* Writes s as a quoted CSV field */
+static void
+write_csv_string(FILE *out, const char *s)
+{
+    fputc('"', out);
+    for (; *s; ++s)
+    {
+        if (*s == '"')
+        {
+            fputc('"', out);
+        }
+        fputc(*s, out);
+    }
+    fputc('"', out);
+}
+
+static void
+write_csv(const Sweep *sweep, FILE *out)
+{
+    static const char *status[] = {"HALT", "TIMEOUT", "ERROR"};
+    const Sweep_Result *r;
+    char program[256];
+    int i, p, config, hazard;
+
+    fprintf(out, "program,pipeline");
+    for (p = 0; p < sweep->num_params; ++p)
+    {
+        if (sweep->params[p].opcode != SWEEP_PIPELINE)
+        {
+            fprintf(out, ",%s_latency", sweep->params[p].name);
+        }
+    }
+    fprintf(out, ",status,cycles,instructions,cpi,stall_cycles\n");
+
+    for (i = 0; i < sweep->num_programs * sweep->num_configs; ++i)
+    {
+        r = &sweep->results[i];
+        config = i % sweep->num_configs;
+        APEX_program_label(&sweep->programs[i / sweep->num_configs], program, sizeof(program));
+        write_csv_string(out, program);
+
+        hazard = sweep->hazard;
+        for (p = 0; p < sweep->num_params; ++p)
+        {
+            if (sweep->params[p].opcode == SWEEP_PIPELINE)
+            {
+                hazard = config_value(sweep, config, p);
+            }
+        }
+        fprintf(out, ",%s", APEX_hazard_name(hazard));
+        for (p = 0; p < sweep->num_params; ++p)
+        {
+            if (sweep->params[p].opcode != SWEEP_PIPELINE)
+            {
+                fprintf(out, ",%d", config_value(sweep, config, p));
+            }
+        }
+        fprintf(out, ",%s,%d,%d,%.4f,%d\n", status[r->status], r->cycles, r->insns,
+                r->insns ? (double)r->cycles / r->insns : 0.0, r->stall_cycles);
+    }
+}
+
+/*
+ * Simulates every program listed in source (see APEX_batch_collect) under
+ * every configuration of the grid file, for at most max_cycles cycles each,
+ * on threads host threads, and writes the CSV to out. Programs run with the
+ * hazard policy hazard unless the grid sweeps the pipeline.
+ *
+ * Returns the number of points that did not halt, or -1 if source or the
+ * grid can not be read.
+ */
+int
+APEX_sweep_run(const char *source, const char *grid, int hazard, int threads, int max_cycles,
+               FILE *out)
+{
+    Sweep sweep;
+    int points, i;
+    int failed = 0;
+
+    memset(&sweep, 0, sizeof(sweep));
+    sweep.hazard = hazard;
+    sweep.max_cycles = max_cycles;
+    if (read_grid(&sweep, grid) != 0)
+    {
+        return -1;
+    }
+
+    sweep.num_programs = APEX_batch_collect(source, &sweep.programs);
+    if (sweep.num_programs < 0)
+    {
+        fprintf(stderr, "APEX_Error: Unable to read %s\n", source);
+        return -1;
+    }
+
+    points = sweep.num_programs * sweep.num_configs;
+    sweep.templates = calloc(sweep.num_programs ? sweep.num_programs : 1, sizeof(APEX_CPU *));
+    sweep.results = calloc(points ? points : 1, sizeof(Sweep_Result));
+    if (!sweep.templates || !sweep.results)
+    {
+        failed = -1;
+        goto out;
+    }
+
+    APEX_run_parallel(sweep.num_programs, threads, load_program, &sweep);
+    APEX_run_parallel(points, threads, run_point, &sweep);
+    write_csv(&sweep, out);
+
+    for (i = 0; i < points; ++i)
+    {
+        if (sweep.results[i].status != SWEEP_HALTED)
+        {
+            failed++;
+        }
+    }
+
+out:
+    for (i = 0; sweep.templates && i < sweep.num_programs; ++i)
+    {
+        if (sweep.templates[i])
+        {
+            APEX_cpu_stop(sweep.templates[i]);
+        }
+    }
+    free(sweep.templates);
+    free(sweep.results);
+    APEX_batch_free(sweep.programs, sweep.num_programs);
+    return failed;
+}
@@ -0,0 +1,264 @@
+/*
+ * apex_trace.c
+ * Contains the binary trace: instead of printing every stage and the whole
+ * register file and data memory each cycle, APEX_cpu_run records
+ * fixed-size events (APEX_Trace_Event) into a lock-free single-producer
+ * single-consumer ring, which a writer thread drains to the trace file.
+ * apex_trace_decode renders the usual text output from the file.
+ *
+ * File layout, host byte order:
+ *
+ *   APEX_Trace_Header
+ *   input file path, program_len bytes, not NUL terminated
+ *   APEX_Trace_Event, until the end of the file
+ *
+ * The trace starts with the nonzero registers and data memory words and
+ * the flags of the CPU as TRACE_REG, TRACE_MEM and TRACE_FLAGS events, so
+ * runs resumed from a checkpoint or after fast-forward decode correctly.
+ */
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "apex_cpu.h"
+#include "apex_macros.h"
+
+_Static_assert(sizeof(APEX_Trace_Event) == 24, "APEX_Trace_Event layout changed");
+_Static_assert((TRACE_RING_SIZE & (TRACE_RING_SIZE - 1)) == 0,
+               "TRACE_RING_SIZE should be a power of two");
+
+struct APEX_Trace
+{
+    APEX_Trace_Event *ring;   /* TRACE_RING_SIZE events */
+    unsigned int head;        /* Next event written, advanced by the simulation */
+    unsigned int tail;        /* Next event drained, advanced by the writer */
+    int done;                 /* No more events will be written */
+    int failed;               /* A write to the file failed */
+    FILE *fp;
+    pthread_t writer;
+};
+
+/* Writes the events in [tail, head) to the file, in at most two pieces
+ * as the ring wraps */
+static void
+drain_ring(APEX_Trace *trace, unsigned int head)
+{
+    unsigned int tail = trace->tail;
+    unsigned int start, count;
+
+    while (tail != head)
+    {
+        start = tail & (TRACE_RING_SIZE - 1);
+        count = head - tail;
+        if (count > TRACE_RING_SIZE - start)
+        {
+            count = TRACE_RING_SIZE - start;
+        }
+        if (fwrite(&trace->ring[start], sizeof(APEX_Trace_Event), count, trace->fp) != count)
+        {
+            trace->failed = TRUE;
+        }
+        tail += count;
+
+        /* The slots are free for the simulation once written */
+        __atomic_store_n(&trace->tail, tail, __ATOMIC_RELEASE);
+    }
+}
+
+static void *
+trace_writer(void *arg)
+{
+    APEX_Trace *trace = arg;
+    struct timespec pause = {0, 100000};
+    unsigned int head;
+    int done;
+
+    for (;;)
+    {
+        /* done is read first, so every event written before it is seen */
+        done = __atomic_load_n(&trace->done, __ATOMIC_ACQUIRE);
+        head = __atomic_load_n(&trace->head, __ATOMIC_ACQUIRE);
+        if (head != trace->tail)
+        {
+            drain_ring(trace, head);
+        }
+        else if (done)
+        {
+            break;
+        }
+        else
+        {
+            nanosleep(&pause, NULL);
+        }
+    }
+    return NULL;
+}
+
+/* Next free slot of the ring. When the writer falls a full ring behind,
+ * the simulation waits for it, so no event is lost */
+static APEX_Trace_Event *
+next_event(APEX_Trace *trace)
+{
+    APEX_Trace_Event *event;
+
+    while (trace->head - __atomic_load_n(&trace->tail, __ATOMIC_ACQUIRE) == TRACE_RING_SIZE)
+    {
+        sched_yield();
+    }
+
+    event = &trace->ring[trace->head & (TRACE_RING_SIZE - 1)];
+    memset(event, 0, sizeof(*event));
+    return event;
+}
+
+/* Hands the slot returned by next_event to the writer */
+static void
+commit_event(APEX_Trace *trace)
+{
+    __atomic_store_n(&trace->head, trace->head + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Records an event whose fields beyond the type are cycle, addr and
+ * value[0]: TRACE_CYCLE, TRACE_REG, TRACE_MEM, TRACE_FLAGS, TRACE_IDLE and
+ * TRACE_HALT, see APEX_Trace_Event
+ */
+void
+APEX_trace_value(APEX_Trace *trace, int type, int cycle, int addr, int value)
+{
+    APEX_Trace_Event *event = next_event(trace);
+
+    event->type = type;
+    event->cycle = cycle;
+    event->addr = addr;
+    event->value[0] = value;
+    commit_event(trace);
+}
+
+/* Records the instruction in a pipeline latch of cpu */
+void
+APEX_trace_stage(APEX_Trace *trace, const APEX_CPU *cpu, int stage, const CPU_Stage *latch)
+{
+    APEX_Trace_Event *event = next_event(trace);
+
+    event->type = TRACE_STAGE;
+    event->cycle = cpu->clock;
+    event->stage = stage;
+    event->addr = latch->pc;
+    event->opcode = latch->insn->opcode;
+
+    if (stage == STAGE_DECODE)
+    {
+        event->stall = cpu->stall_pipeline ? cpu->stall_reason : STALL_NONE;
+        if (cpu->bypass.ex_forwarded)
+        {
+            event->forwarded |= TRACE_FORWARD_EX;
+            event->tag[0] = cpu->bypass.ex_tag_forwarded;
+            event->value[0] = cpu->bypass.ex_value_forwarded;
+        }
+        if (cpu->bypass.mem_forwarded)
+        {
+            event->forwarded |= TRACE_FORWARD_MEM;
+            event->tag[1] = cpu->bypass.mem_tag_forwarded;
+            event->value[1] = cpu->bypass.mem_value_forwarded;
+        }
+    }
+    commit_event(trace);
+}
+
+/*
+ * Creates the trace file path for a run of cpu, records its current
+ * architectural state and starts the writer thread.
+ * Returns NULL if the file can not be written
+ */
+APEX_Trace *
+APEX_trace_open(const char *path, const APEX_CPU *cpu)
+{
+    APEX_Trace_Header header;
+    APEX_Trace *trace;
+    int i, addr;
+
+    trace = calloc(1, sizeof(APEX_Trace));
+    if (!trace)
+    {
+        return NULL;
+    }
+    trace->ring = malloc(TRACE_RING_SIZE * sizeof(APEX_Trace_Event));
+    trace->fp = fopen(path, "wb");
+    if (!trace->ring || !trace->fp)
+    {
+        goto fail;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    header.version = TRACE_VERSION;
+    header.header_size = sizeof(header);
+    header.event_size = sizeof(APEX_Trace_Event);
+    header.program_len = strlen(cpu->filename);
+    if (fwrite(&header, sizeof(header), 1, trace->fp) != 1
+        || fwrite(cpu->filename, 1, header.program_len, trace->fp) != header.program_len)
+    {
+        goto fail;
+    }
+
+    if (pthread_create(&trace->writer, NULL, trace_writer, trace) != 0)
+    {
+        goto fail;
+    }
+
+    for (i = 0; i < REG_FILE_SIZE; ++i)
+    {
+        if (cpu->regs[i])
+        {
+            APEX_trace_value(trace, TRACE_REG, cpu->clock, i, cpu->regs[i]);
+        }
+    }
+    for (i = 0; i < cpu->mem_index_len; ++i)
+    {
+        addr = cpu->mem_index[i];
+        if (cpu->data_memory[addr])
+        {
+            APEX_trace_value(trace, TRACE_MEM, cpu->clock, addr, cpu->data_memory[addr]);
+        }
+    }
+    APEX_trace_value(trace, TRACE_FLAGS, cpu->clock, 0,
+                     (cpu->zero_flag ? TRACE_FLAG_ZERO : 0)
+                         | (cpu->positive_flag ? TRACE_FLAG_POSITIVE : 0)
+                         | (cpu->negative_flag ? TRACE_FLAG_NEGATIVE : 0));
+    return trace;
+
+fail:
+    if (trace->fp)
+    {
+        fclose(trace->fp);
+    }
+    free(trace->ring);
+    free(trace);
+    return NULL;
+}
+
+/*
+ * Waits for the writer to drain every event and closes the trace.
+ * Returns 0 on success, -1 if the file could not be written completely
+ */
+int
+APEX_trace_close(APEX_Trace *trace)
+{
+    int failed;
+
+    __atomic_store_n(&trace->done, TRUE, __ATOMIC_RELEASE);
+    pthread_join(trace->writer, NULL);
+
+    failed = trace->failed;
+    if (fclose(trace->fp) != 0)
+    {
+        failed = TRUE;
+    }
+    free(trace->ring);
+    free(trace);
+    return failed ? -1 : 0;
+}
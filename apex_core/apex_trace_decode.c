@@ -0,0 +1,288 @@
+/*
+ * apex_trace_decode.c
+ * Renders a binary trace written by `apex_sim <input_file> trace <file>`
+ * (see apex_trace.c) as the text apex_sim prints with debug messages on:
+ * the code memory listing, every stage of every cycle and the register
+ * file, data memory and flags after each cycle. The cycles of a TRACE_IDLE
+ * event are printed one by one too.
+ *
+ * The input file recorded in the trace is parsed again to print the
+ * instructions, so it must not have changed since the run.
+ *
+ * With detail 1, every decode line is followed by why the instruction was
+ * held in decode and the values forwarded into it.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_cpu.h"
+#include "apex_macros.h"
+
+/* Latch of a STAGE_* stage */
+static CPU_Stage *
+cpu_latch(APEX_CPU *cpu, int stage)
+{
+    CPU_Stage *latches[NUM_STAGES] = {
+        &cpu->fetch, &cpu->decode, &cpu->execute, &cpu->memory, &cpu->writeback};
+
+    return latches[stage];
+}
+
+static void
+print_cycle_header(FILE *out, int cycle)
+{
+    fprintf(out, "--------------------------------------------\n");
+    fprintf(out, "Clock Cycle #: %d\n", cycle);
+    fprintf(out, "--------------------------------------------\n");
+}
+
+/* Stall reason and forwarded values of a decode event */
+static void
+print_decode_detail(FILE *out, const APEX_Trace_Event *event)
+{
+    fprintf(out, "%-15s: ", "");
+    if (event->stall)
+    {
+        fprintf(out, "stalled%s%s", event->stall & STALL_EXECUTE_BUSY ? " (execute busy)" : "",
+                event->stall & STALL_OPERANDS ? " (operands)" : "");
+    }
+    else
+    {
+        fprintf(out, "issued");
+    }
+    if (event->forwarded & TRACE_FORWARD_EX)
+    {
+        fprintf(out, ", R%d=%d from EX/MEM", event->tag[0], event->value[0]);
+    }
+    if (event->forwarded & TRACE_FORWARD_MEM)
+    {
+        fprintf(out, ", R%d=%d from MEM/WB", event->tag[1], event->value[1]);
+    }
+    fprintf(out, "\n");
+}
+
+/*
+ * Prints the cycles first to last, which apex_sim skipped as only execute
+ * counted down in them (see idle_cycles in apex_cpu.c). Memory and
+ * writeback are empty; the stages in the mask reported, those reported in
+ * the cycle before, hold the same instructions, and the one in decode
+ * stalls as it did then (decode_event, with detail)
+ */
+static void
+print_idle_cycles(APEX_CPU *cpu, int first, int last, int reported,
+                  const APEX_Trace_Event *decode_event)
+{
+    int cycle, stage;
+
+    for (cycle = first; cycle <= last; ++cycle)
+    {
+        print_cycle_header(cpu->out, cycle);
+        for (stage = STAGE_EXECUTE; stage >= STAGE_FETCH; --stage)
+        {
+            if (reported & (1 << stage))
+            {
+                APEX_cpu_print_stage(cpu, stage);
+                if (decode_event && stage == STAGE_DECODE)
+                {
+                    print_decode_detail(cpu->out, decode_event);
+                }
+            }
+        }
+        APEX_cpu_print_state(cpu);
+    }
+}
+
+/* Points the latch of the event's stage at the instruction it held */
+static int
+load_latch(APEX_CPU *cpu, const APEX_Trace_Event *event)
+{
+    CPU_Stage *latch;
+    int index = (event->addr - 4000) / 4;
+
+    /* Past the end of the program, the CPU fetches the sentinel entry */
+    if (event->addr < 4000 || index > cpu->code_memory_size)
+    {
+        index = cpu->code_memory_size;
+    }
+    if (event->stage >= NUM_STAGES || cpu->code_memory[index].opcode != event->opcode)
+    {
+        return -1;
+    }
+
+    latch = cpu_latch(cpu, event->stage);
+    latch->pc = event->addr;
+    latch->insn = &cpu->code_memory[index];
+    return 0;
+}
+
+static APEX_CPU *
+open_trace(FILE *fp, const char *path)
+{
+    APEX_Trace_Header header;
+    APEX_CPU *cpu;
+    char *program;
+
+    if (fread(&header, sizeof(header), 1, fp) != 1
+        || memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0
+        || header.version != TRACE_VERSION || header.header_size != sizeof(header)
+        || header.event_size != sizeof(APEX_Trace_Event))
+    {
+        fprintf(stderr, "APEX_Error: %s is not a version %d APEX trace\n", path,
+                TRACE_VERSION);
+        return NULL;
+    }
+
+    program = calloc(1, header.program_len + 1);
+    if (!program || fread(program, 1, header.program_len, fp) != header.program_len)
+    {
+        fprintf(stderr, "APEX_Error: %s is corrupt\n", path);
+        free(program);
+        return NULL;
+    }
+
+    cpu = APEX_cpu_create(program, 0, stdout);
+    if (!cpu)
+    {
+        fprintf(stderr, "APEX_Error: Unable to load %s from trace\n", program);
+    }
+    free(program);
+    return cpu;
+}
+
+int
+main(int argc, char const *argv[])
+{
+    APEX_Trace_Event event;
+    APEX_CPU *cpu;
+    FILE *fp;
+    int detail = 0;
+    APEX_Trace_Event decode_event;
+    int cycle_open = FALSE;
+    int reported = 0;
+    int ret = 0;
+
+    if (argc != 2 && !(argc == 4 && strcmp(argv[2], "detail") == 0))
+    {
+        fprintf(stderr, "APEX_Help: Usage %s <trace_file> [detail <0|1>]\n", argv[0]);
+        exit(1);
+    }
+    if (argc == 4)
+    {
+        detail = atoi(argv[3]);
+    }
+
+    fp = fopen(argv[1], "rb");
+    if (!fp)
+    {
+        fprintf(stderr, "APEX_Error: Unable to open trace %s\n", argv[1]);
+        exit(1);
+    }
+    cpu = open_trace(fp, argv[1]);
+    if (!cpu)
+    {
+        fclose(fp);
+        exit(1);
+    }
+    APEX_cpu_print_code_memory(cpu);
+
+    while (ret == 0 && fread(&event, sizeof(event), 1, fp) == 1)
+    {
+        switch (event.type)
+        {
+        case TRACE_CYCLE:
+        {
+            if (cycle_open)
+            {
+                APEX_cpu_print_state(cpu);
+            }
+            print_cycle_header(cpu->out, event.cycle);
+            cycle_open = TRUE;
+            reported = 0;
+            break;
+        }
+
+        case TRACE_STAGE:
+        {
+            if (load_latch(cpu, &event) != 0)
+            {
+                fprintf(stderr, "APEX_Error: %s does not match its program at pc %d\n",
+                        argv[1], event.addr);
+                ret = 1;
+                break;
+            }
+            APEX_cpu_print_stage(cpu, event.stage);
+            reported |= 1 << event.stage;
+            if (event.stage == STAGE_DECODE)
+            {
+                decode_event = event;
+            }
+            if (detail && event.stage == STAGE_DECODE)
+            {
+                print_decode_detail(cpu->out, &event);
+            }
+            break;
+        }
+
+        case TRACE_REG:
+        {
+            cpu->regs[event.addr & (REG_FILE_SIZE - 1)] = event.value[0];
+            break;
+        }
+
+        case TRACE_MEM:
+        {
+            if (event.addr >= 0 && event.addr < DATA_MEMORY_SIZE)
+            {
+                APEX_cpu_store(cpu, event.addr, event.value[0]);
+            }
+            break;
+        }
+
+        case TRACE_FLAGS:
+        {
+            cpu->zero_flag = (event.value[0] & TRACE_FLAG_ZERO) ? TRUE : FALSE;
+            cpu->positive_flag = (event.value[0] & TRACE_FLAG_POSITIVE) ? TRUE : FALSE;
+            cpu->negative_flag = (event.value[0] & TRACE_FLAG_NEGATIVE) ? TRUE : FALSE;
+            break;
+        }
+
+        case TRACE_IDLE:
+        {
+            if (cycle_open)
+            {
+                APEX_cpu_print_state(cpu);
+                cycle_open = FALSE;
+            }
+            print_idle_cycles(cpu, event.cycle, event.value[0], reported,
+                              detail ? &decode_event : NULL);
+            break;
+        }
+
+        case TRACE_HALT:
+        {
+            fprintf(cpu->out, "APEX_CPU: Simulation Complete, cycles = %d instructions = %d\n",
+                    event.cycle, event.value[0]);
+            cycle_open = FALSE;
+            break;
+        }
+
+        default:
+        {
+            fprintf(stderr, "APEX_Error: %s is corrupt\n", argv[1]);
+            ret = 1;
+            break;
+        }
+        }
+    }
+
+    /* The run stopped at its cycle limit */
+    if (ret == 0 && cycle_open)
+    {
+        APEX_cpu_print_state(cpu);
+    }
+
+    fclose(fp);
+    APEX_cpu_stop(cpu);
+    return ret;
+}
@@ -0,0 +1,108 @@
+#!/bin/sh
+#
+# run_bench.sh
+# Runs every kernel of bench.list under each pipeline, checks its cycle
+# count against the list and its final state against expected/, and
+# reports host MIPS (retired instructions per second of the whole
+# apex_sim process); run by `make bench`
+#
+# Usage: run_bench.sh [-u] <apex_sim>
+#   -u  rewrite the expected cycle counts and states from this simulator
+
+UPDATE=0
+if [ "$1" = "-u" ]
+then
+    UPDATE=1
+    shift
+fi
+SIM=$1
+DIR=$(dirname "$0")
+PIPELINES="stalling forwarding bypass"
+MAX_CYCLES=10000000
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+failed=0
+printf "%-9s %5s %-10s %9s %9s %9s %8s  %s\n" "kernel" "n" "pipeline" "cycles" "expected" \
+    "insns" "MIPS" "result"
+
+while IFS= read -r line
+do
+    case "$line" in
+    ''|'#'*)
+        echo "$line" >> "$TMP/bench.list"
+        continue
+        ;;
+    esac
+
+    set -- $line
+    kernel=$1
+    n=$2
+    shift 2
+    prog="$TMP/$kernel-$n.asm"
+    state="$DIR/expected/$kernel-$n.state"
+    sed "s/@N@/$n/g" "$DIR/kernels/$kernel.asm.in" > "$prog"
+    row="$kernel $n"
+
+    for pipeline in $PIPELINES
+    do
+        expected=$1
+        shift
+
+        start=$(date +%s%N)
+        counts=$("$SIM" "$prog" log 0 simulate $MAX_CYCLES pipeline $pipeline \
+                     state "$TMP/state" 2>/dev/null \
+                 | sed -n 's/.*Simulation Complete, cycles = \([0-9]*\) instructions = \([0-9]*\)$/\1 \2/p')
+        end=$(date +%s%N)
+
+        if [ -z "$counts" ]
+        then
+            printf "%-9s %5s %-10s %9s %9s %9s %8s  %s\n" "$kernel" "$n" "$pipeline" "-" \
+                "$expected" "-" "-" "did not halt"
+            failed=$((failed + 1))
+            row="$row $expected"
+            continue
+        fi
+        cycles=${counts% *}
+        insns=${counts#* }
+        mips=$(awk -v i="$insns" -v ns=$((end - start)) 'BEGIN { printf "%.2f", i * 1000 / ns }')
+
+        # The state of the first pipeline is the reference for the others
+        if [ $UPDATE = 1 ]
+        then
+            expected=$cycles
+            if [ "$pipeline" = "${PIPELINES%% *}" ]
+            then
+                cp "$TMP/state" "$state"
+            fi
+        fi
+
+        result=ok
+        if ! cmp -s "$TMP/state" "$state"
+        then
+            result="wrong final state"
+        elif [ "$cycles" != "$expected" ]
+        then
+            result="cycles changed"
+        fi
+        if [ "$result" != ok ]
+        then
+            failed=$((failed + 1))
+        fi
+
+        printf "%-9s %5s %-10s %9s %9s %9s %8s  %s\n" "$kernel" "$n" "$pipeline" "$cycles" \
+            "$expected" "$insns" "$mips" "$result"
+        row="$row $expected"
+    done
+    echo "$row" | awk '{ printf "%-9s %-4s %s %s %s\n", $1, $2, $3, $4, $5 }' >> "$TMP/bench.list"
+done < "$DIR/bench.list"
+
+if [ $UPDATE = 1 ]
+then
+    cp "$TMP/bench.list" "$DIR/bench.list"
+fi
+if [ $failed -gt 0 ]
+then
+    echo "$failed runs failed"
+    exit 1
+fi
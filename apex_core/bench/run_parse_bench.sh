@@ -0,0 +1,44 @@
+#!/bin/sh
+#
+# run_parse_bench.sh
+# Generates a program of about a million instructions (about 13 MB of
+# text) using every mnemonic, and reports how fast apex_sim parses it in
+# MB/s and instructions/s, then how fast it loads the same program
+# assembled by apex-as; run by `make bench-parse`
+#
+# Usage: run_parse_bench.sh <apex_sim> [instructions] [repetitions]
+
+SIM=$1
+AS=$(dirname "$SIM")/apex-as
+INSNS=${2:-1000000}
+REPS=${3:-5}
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+awk -v n="$INSNS" 'BEGIN {
+    split("ADD ADDL SUB SUBL MUL DIV AND OR EXOR EX-OR MOVC LOAD STOREP LOADP " \
+          "STORE BZ BNZ BP BNP BN BNN CMP CML JUMP JALR NOP", op, " ")
+    for (i = 0; i < n; i++) {
+        m = op[i % 26 + 1]
+        d = i % 16; a = (i + 5) % 16; b = (i + 11) % 16
+        if (m == "MOVC" || m == "ADDL" || m == "SUBL" || m == "LOAD" || m == "LOADP" || m == "JALR")
+            printf "%s R%d,R%d,#%d\n", m, d, a, i % 1000
+        else if (m == "STORE" || m == "STOREP")
+            printf "%s R%d,R%d,#%d\n", m, d, a, i % 1000
+        else if (m ~ /^B/)
+            printf "%s #%d\n", m, 4 * (i % 64) - 128
+        else if (m == "CMP")
+            printf "%s R%d,R%d\n", m, a, b
+        else if (m == "CML" || m == "JUMP")
+            printf "%s R%d,#%d\n", m, a, i % 1000
+        else if (m == "NOP")
+            print m
+        else
+            printf "%s R%d,R%d,R%d\n", m, d, a, b
+    }
+    print "HALT"
+}' > "$TMP/parse.asm"
+
+"$SIM" "$TMP/parse.asm" parsebench "$REPS"
+"$AS" "$TMP/parse.asm" output "$TMP/parse.apexbin" > /dev/null &&
+    "$SIM" "$TMP/parse.apexbin" parsebench "$REPS"
@@ -0,0 +1,82 @@
+#!/bin/sh
+#
+# run_selfbench.sh
+# Host throughput of the simulator, run by `make selfbench`: times short
+# and long programs with `apex_sim selfbench` (see apex_selfbench.c),
+# writes the CSV to the results file and compares the median host time per
+# simulated cycle of every row with selfbench_baseline.csv. Rows more than
+# TOLERANCE (default 0.20) slower than the baseline fail the run; TRIALS
+# (default 11) trials are counted per row.
+#
+# The baseline only holds for the host it was recorded on; record one for
+# yours with -u before making the changes to be measured. On a busy host,
+# raise TRIALS before TOLERANCE.
+#
+# Usage: run_selfbench.sh [-u] <apex_sim> [results.csv]
+#   -u  record the results as the new baseline
+
+UPDATE=0
+if [ "$1" = "-u" ]
+then
+    UPDATE=1
+    shift
+fi
+SIM=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+RESULTS=${2:-selfbench.csv}
+DIR=$(cd "$(dirname "$0")" && pwd)
+BASELINE="$DIR/selfbench_baseline.csv"
+TOLERANCE=${TOLERANCE:-0.20}
+TRIALS=${TRIALS:-11}
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+# Short programs (the sample input.asm next to apex_sim and a small
+# kernel) run a few hundred cycles at most, long ones about ten
+# thousand. Verbose cycles print every nonzero data memory word, so the
+# long ones keep their data small
+cp "$(dirname "$SIM")/input.asm" "$TMP/short-input.asm"
+for program in short-fib-24 long-isort-64 long-matmul-8
+do
+    kernel=${program#*-}
+    sed -e '/^---/d' -e "s/@N@/${kernel##*-}/g" "$DIR/kernels/${kernel%-*}.asm.in" \
+        > "$TMP/$program.asm"
+done
+
+(cd "$TMP" && "$SIM" selfbench . simulate 1000000 trials $TRIALS warmup 2 csv results.csv) || exit 1
+cp "$TMP/results.csv" "$RESULTS"
+
+if [ $UPDATE = 1 ]
+then
+    cp "$RESULTS" "$BASELINE"
+    echo "Baseline recorded in $BASELINE"
+    exit 0
+fi
+
+awk -F, -v tolerance="$TOLERANCE" '
+    FNR == 1 { next }
+    NR == FNR { baseline[$1 "," $2 "," $3] = $7; next }
+    {
+        key = $1 "," $2 "," $3
+        if (!(key in baseline))
+        {
+            printf "%-22s %-10s %-8s %12s %12.2f  %s\n", $1, $2, $3, "-", $7, "no baseline"
+            next
+        }
+        change = $7 / baseline[key] - 1
+        result = change > tolerance ? "SLOWER" : "ok"
+        failed += result != "ok"
+        printf "%-22s %-10s %-8s %12.2f %12.2f %+7.1f%%  %s\n", $1, $2, $3, baseline[key], $7,
+               100 * change, result
+    }
+    END { exit failed > 0 }
+' "$BASELINE" "$RESULTS" > "$TMP/report"
+status=$?
+
+printf "%-22s %-10s %-8s %12s %12s %8s\n" "program" "pipeline" "output" "base ns/cyc" \
+    "ns/cyc" "change"
+cat "$TMP/report"
+if [ $status != 0 ]
+then
+    echo "Slower than the baseline by more than $TOLERANCE"
+fi
+exit $status
@@ -0,0 +1,44 @@
+#!/bin/sh
+#
+# bench_dispatch.sh
+# Functional core throughput with threaded and switch dispatch on every
+# test case of the given multi-program files, run by `make bench-dispatch`
+#
+# Usage: bench_dispatch.sh <reps> <file>...
+
+REPS=$1
+shift
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+mips()
+{
+    "$1" "$2" ffbench "$REPS" 2>/dev/null | sed -n 's/.* \([0-9.]*\) MIPS$/\1/p'
+}
+
+printf "%-16s %-6s %12s %12s %8s\n" "file" "test" "switch MIPS" "threaded MIPS" "speedup"
+for file in "$@"
+do
+    # One program per ---TC n--- section, without blank lines, each line
+    # ending in a single space as the parser expects
+    awk -v dir="$TMP" '
+        /^---/ { n++; next }
+        /^[ \t\r]*$/ { next }
+        n > 0 { sub(/[ \t\r]*$/, " "); print > (dir "/tc" n ".asm") }
+    ' "$file"
+
+    for prog in $(ls "$TMP"/tc*.asm 2>/dev/null | sort -V)
+    do
+        test=$(basename "$prog" .asm)
+        switch=$(mips ./apex_sim_switch "$prog")
+        threaded=$(mips ./apex_sim "$prog")
+        if [ -z "$switch" ] || [ -z "$threaded" ]
+        then
+            printf "%-16s %-6s %s\n" "$file" "$test" "does not assemble"
+        else
+            awk -v f="$file" -v t="$test" -v s="$switch" -v d="$threaded" \
+                'BEGIN { printf "%-16s %-6s %12s %12s %7.2fx\n", f, t, s, d, d / s }'
+        fi
+    done
+    rm -f "$TMP"/tc*.asm
+done
@@ -0,0 +1,921 @@
+/*
+ * file_parser.c
+ * Contains functions to parse input file and create code memory, you can edit
+ * this file to add new instructions
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#include <assert.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "apex_cpu.h"
+#include "apex_macros.h"
+
+/*
+ * The input file is read through a read-only mapping in a single pass: each
+ * line is scanned in place, without copying it or splitting it into
+ * strings. Files that can not be mapped (pipes, /dev/stdin) are read into
+ * a buffer instead.
+ */
+typedef struct Source_File
+{
+    const char *data;
+    size_t size;
+    int mapped;    /* data is a mapping rather than a malloc'd copy */
+} Source_File;
+
+/* Returns -1 if the file can not be read */
+static int
+open_source(const char *filename, Source_File *src)
+{
+    struct stat st;
+    char *buf = NULL;
+    char *grown;
+    size_t capacity = 0;
+    ssize_t nread;
+    void *data;
+    int fd;
+
+    memset(src, 0, sizeof(*src));
+    fd = open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
+    {
+        /* An empty file has no lines, and can not be mapped */
+        if (st.st_size == 0)
+        {
+            close(fd);
+            return 0;
+        }
+        data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED)
+        {
+            madvise(data, st.st_size, MADV_SEQUENTIAL);
+            src->data = data;
+            src->size = st.st_size;
+            src->mapped = TRUE;
+            close(fd);
+            return 0;
+        }
+    }
+
+    for (;;)
+    {
+        if (src->size == capacity)
+        {
+            capacity = capacity ? 2 * capacity : 65536;
+            grown = realloc(buf, capacity);
+            if (!grown)
+            {
+                free(buf);
+                close(fd);
+                return -1;
+            }
+            buf = grown;
+        }
+        nread = read(fd, buf + src->size, capacity - src->size);
+        if (nread <= 0)
+        {
+            break;
+        }
+        src->size += nread;
+    }
+    close(fd);
+
+    if (nread != 0)
+    {
+        free(buf);
+        return -1;
+    }
+    src->data = buf;
+    return 0;
+}
+
+static void
+close_source(Source_File *src)
+{
+    if (src->mapped)
+    {
+        munmap((void *)src->data, src->size);
+    }
+    else
+    {
+        free((void *)src->data);
+    }
+}
+
+/* Returns the line starting at *pos and sets len to its length without the
+ * newline, then moves *pos to the next line. Returns NULL past the end */
+static const char *
+next_line(const Source_File *src, size_t *pos, size_t *len)
+{
+    const char *line = src->data + *pos;
+    const char *newline;
+
+    if (*pos >= src->size)
+    {
+        return NULL;
+    }
+
+    newline = memchr(line, '\n', src->size - *pos);
+    *len = newline ? (size_t)(newline - line) : src->size - *pos;
+    *pos += *len + (newline != NULL);
+    return line;
+}
+
+/*
+ * Program images (.apexbin, written by apex-as) hold instructions already
+ * parsed, so loading one only expands each into code memory. An image is
+ * recognized by BINARY_MAGIC, whatever its file name.
+ */
+static int
+is_binary_image(const Source_File *src)
+{
+    return src->size >= sizeof(BINARY_MAGIC)
+           && memcmp(src->data, BINARY_MAGIC, sizeof(BINARY_MAGIC)) == 0;
+}
+
+/* Returns the header of the program image in src, or NULL if it is not a
+ * complete version BINARY_VERSION image */
+static const APEX_Binary_Header *
+get_binary_header(const Source_File *src, const char *filename)
+{
+    const APEX_Binary_Header *header = (const APEX_Binary_Header *)src->data;
+
+    if (src->size >= sizeof(*header) && header->version == BINARY_VERSION
+        && header->header_size == sizeof(*header)
+        && header->insn_size == sizeof(APEX_Binary_Insn)
+        && sizeof(*header) + (uint64_t)header->insn_count * sizeof(APEX_Binary_Insn)
+                   + (uint64_t)header->data_count * sizeof(APEX_Binary_Data)
+                   + (uint64_t)header->symbol_count * sizeof(APEX_Binary_Symbol)
+               <= src->size)
+    {
+        return header;
+    }
+
+    fprintf(stderr, "APEX_Error: %s is not a version %d APEX program image\n", filename,
+            BINARY_VERSION);
+    return NULL;
+}
+
+static const APEX_Binary_Insn *
+binary_insns(const APEX_Binary_Header *header)
+{
+    return (const APEX_Binary_Insn *)(header + 1);
+}
+
+static const APEX_Binary_Data *
+binary_data(const APEX_Binary_Header *header)
+{
+    return (const APEX_Binary_Data *)(binary_insns(header) + header->insn_count);
+}
+
+static const APEX_Binary_Symbol *
+binary_symbols(const APEX_Binary_Header *header)
+{
+    return (const APEX_Binary_Symbol *)(binary_data(header) + header->data_count);
+}
+
+/*
+ * Value of an operand token such as R12 or #-4: the number after its first
+ * character, read like atoi() but never past the end of the token
+ */
+static int
+get_num_from_token(const char *token, const char *end)
+{
+    unsigned int value = 0;
+    int negative = FALSE;
+
+    for (token++; token < end && (*token == '\t' || *token == '\v' || *token == '\f');
+         ++token)
+    {
+    }
+    if (token < end && (*token == '-' || *token == '+'))
+    {
+        negative = *token == '-';
+        token++;
+    }
+    for (; token < end && *token >= '0' && *token <= '9'; ++token)
+    {
+        value = 10 * value + (*token - '0');
+    }
+
+    return negative ? -(int)value : (int)value;
+}
+
+/*
+ * Register number of an operand token such as R12, read as
+ * get_num_from_token does. Returns -1 if it is not one of the
+ * REG_FILE_SIZE registers
+ */
+static int
+get_register_from_token(const char *token, const char *end)
+{
+    int value = 0;
+    int negative = FALSE;
+
+    for (token++; token < end && (*token == '\t' || *token == '\v' || *token == '\f');
+         ++token)
+    {
+    }
+    if (token < end && (*token == '-' || *token == '+'))
+    {
+        negative = *token == '-';
+        token++;
+    }
+    for (; token < end && *token >= '0' && *token <= '9'; ++token)
+    {
+        value = 10 * value + (*token - '0');
+        if (value >= REG_FILE_SIZE)
+        {
+            return -1;
+        }
+    }
+
+    return (negative && value != 0) ? -1 : value;
+}
+
+/* Mnemonic accepted in the input file. Code memory points at name for
+ * display, so the spelling used in the program is kept as is */
+typedef struct APEX_Mnemonic
+{
+    const char *name;
+    int opcode;
+} APEX_Mnemonic;
+
+#define MNEMONIC_TABLE_SIZE 64
+#define MNEMONIC_MIN_LEN 2
+#define MNEMONIC_MAX_LEN 6
+
+/* Slot of a mnemonic in apex_mnemonics, from its length and its second and
+ * last characters. The multipliers are picked so no two mnemonics share a
+ * slot; change them if a new mnemonic collides */
+#define MNEMONIC_SLOT(len, second, last)                                                 \
+    (((len) + 5 * (unsigned char)(second) + 22 * (unsigned char)(last))                  \
+     & (MNEMONIC_TABLE_SIZE - 1))
+
+/*
+ * Mnemonics by MNEMONIC_SLOT, a perfect hash: a lookup computes one slot
+ * and compares one string. Two mnemonics in the same slot would silently
+ * override each other, so that is made a compile error.
+ *
+ * Note : you can edit apex_mnemonics to add new instructions
+ */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic error "-Woverride-init"
+static const APEX_Mnemonic apex_mnemonics[MNEMONIC_TABLE_SIZE] = {
+    [MNEMONIC_SLOT(3, 'D', 'D')] = {"ADD", OPCODE_ADD},
+    [MNEMONIC_SLOT(4, 'D', 'L')] = {"ADDL", OPCODE_ADDL},
+    [MNEMONIC_SLOT(3, 'U', 'B')] = {"SUB", OPCODE_SUB},
+    [MNEMONIC_SLOT(4, 'U', 'L')] = {"SUBL", OPCODE_SUBL},
+    [MNEMONIC_SLOT(3, 'U', 'L')] = {"MUL", OPCODE_MUL},
+    [MNEMONIC_SLOT(3, 'I', 'V')] = {"DIV", OPCODE_DIV},
+    [MNEMONIC_SLOT(3, 'N', 'D')] = {"AND", OPCODE_AND},
+    [MNEMONIC_SLOT(2, 'R', 'R')] = {"OR", OPCODE_OR},
+    [MNEMONIC_SLOT(4, 'X', 'R')] = {"EXOR", OPCODE_XOR},
+    [MNEMONIC_SLOT(5, 'X', 'R')] = {"EX-OR", OPCODE_XOR},
+    [MNEMONIC_SLOT(4, 'O', 'C')] = {"MOVC", OPCODE_MOVC},
+    [MNEMONIC_SLOT(4, 'O', 'D')] = {"LOAD", OPCODE_LOAD},
+    [MNEMONIC_SLOT(6, 'T', 'P')] = {"STOREP", OPCODE_STOREP},
+    [MNEMONIC_SLOT(5, 'O', 'P')] = {"LOADP", OPCODE_LOADP},
+    [MNEMONIC_SLOT(5, 'T', 'E')] = {"STORE", OPCODE_STORE},
+    [MNEMONIC_SLOT(2, 'Z', 'Z')] = {"BZ", OPCODE_BZ},
+    [MNEMONIC_SLOT(3, 'N', 'Z')] = {"BNZ", OPCODE_BNZ},
+    [MNEMONIC_SLOT(2, 'P', 'P')] = {"BP", OPCODE_BP},
+    [MNEMONIC_SLOT(3, 'N', 'P')] = {"BNP", OPCODE_BNP},
+    [MNEMONIC_SLOT(2, 'N', 'N')] = {"BN", OPCODE_BN},
+    [MNEMONIC_SLOT(3, 'N', 'N')] = {"BNN", OPCODE_BNN},
+    [MNEMONIC_SLOT(4, 'A', 'T')] = {"HALT", OPCODE_HALT},
+    [MNEMONIC_SLOT(3, 'M', 'P')] = {"CMP", OPCODE_CMP},
+    [MNEMONIC_SLOT(3, 'M', 'L')] = {"CML", OPCODE_CML},
+    [MNEMONIC_SLOT(4, 'U', 'P')] = {"JUMP", OPCODE_JUMP},
+    [MNEMONIC_SLOT(4, 'A', 'R')] = {"JALR", OPCODE_JALR},
+    [MNEMONIC_SLOT(3, 'O', 'P')] = {"NOP", OPCODE_NOP},
+};
+#pragma GCC diagnostic pop
+
+/* Returns the entry of the len characters at name, or NULL for an unknown
+ * mnemonic */
+static const APEX_Mnemonic *
+lookup_mnemonic(const char *name, size_t len)
+{
+    const APEX_Mnemonic *entry;
+
+    if (len < MNEMONIC_MIN_LEN || len > MNEMONIC_MAX_LEN)
+    {
+        return NULL;
+    }
+
+    entry = &apex_mnemonics[MNEMONIC_SLOT(len, name[1], name[len - 1])];
+    if (!entry->name || strncmp(entry->name, name, len) != 0 || entry->name[len] != '\0')
+    {
+        return NULL;
+    }
+    return entry;
+}
+
+/* Returns the OPCODE_* value of a mnemonic, or -1 if it is unknown */
+int
+get_opcode_from_string(const char *mnemonic)
+{
+    const APEX_Mnemonic *entry = lookup_mnemonic(mnemonic, strlen(mnemonic));
+
+    return entry ? entry->opcode : -1;
+}
+
+/* Returns the first mnemonic of an opcode in apex_mnemonics, or NULL if it
+ * has none */
+const char *
+get_opcode_name(int opcode)
+{
+    size_t i;
+
+    for (i = 0; i < MNEMONIC_TABLE_SIZE; ++i)
+    {
+        if (apex_mnemonics[i].name && apex_mnemonics[i].opcode == opcode)
+        {
+            return apex_mnemonics[i].name;
+        }
+    }
+
+    return NULL;
+}
+
+/* Returns the register bitmask for the ROLE_* registers of an instruction */
+static unsigned int
+get_role_mask(const APEX_Instruction *ins, int roles)
+{
+    unsigned int mask = 0;
+
+    if (roles & ROLE_RD)
+    {
+        mask |= 1u << ins->rd;
+    }
+    if (roles & ROLE_RS1)
+    {
+        mask |= 1u << ins->rs1;
+    }
+    if (roles & ROLE_RS2)
+    {
+        mask |= 1u << ins->rs2;
+    }
+
+    return mask;
+}
+
+/*
+ * Computes the scoreboard masks of a parsed instruction from its descriptor:
+ * the registers it reads in decode and the registers it holds until writeback
+ */
+static void
+set_register_masks(APEX_Instruction *ins)
+{
+    ins->src_mask = get_role_mask(ins, ins->info->src);
+    ins->dst_mask = get_role_mask(ins, ins->info->dst);
+}
+
+/* Sets up the zeroed entry past the end of code memory, so a fetch running
+ * off the program reads a defined instruction */
+static void
+set_end_of_code(APEX_Instruction *ins)
+{
+    memset(ins, 0, sizeof(APEX_Instruction));
+    ins->opcode_str = "";
+    ins->info = APEX_get_opcode_info(ins->opcode);
+    set_register_masks(ins);
+}
+
+/* Returns the first run of characters other than blanks in [*p, end) and
+ * sets len to its length, moving *p past it */
+static const char *
+next_word(const char **p, const char *end, size_t *len)
+{
+    const char *word;
+
+    while (*p < end && **p == ' ')
+    {
+        (*p)++;
+    }
+    word = *p;
+    while (*p < end && **p != ' ')
+    {
+        (*p)++;
+    }
+    *len = *p - word;
+    return word;
+}
+
+/*
+ * This function is related to parsing input file
+ *
+ * Parses the len characters of an instruction line: the mnemonic, then the
+ * operands separated by commas, both ending at the next blank. Characters
+ * after a carriage return are ignored.
+ *
+ * Note : you can edit this function to add new instructions
+ *
+ * Returns -1 if the opcode is unknown, -2 if a register operand is not one
+ * of R0 to R31
+ */
+static int
+create_APEX_instruction(APEX_Instruction *ins, const char *line, size_t len)
+{
+    const APEX_Mnemonic *mnemonic;
+    const char *p, *end, *operands, *token;
+    size_t mnemonic_len, operands_len;
+    uint8_t *field;
+    int i, reg;
+
+    /* Like a C string, the line also ends at a NUL */
+    end = line;
+    while (end < line + len && *end != '\r' && *end != '\0')
+    {
+        end++;
+    }
+
+    p = line;
+    token = next_word(&p, end, &mnemonic_len);
+    operands = next_word(&p, end, &operands_len);
+
+    mnemonic = lookup_mnemonic(token, mnemonic_len);
+    if (!mnemonic)
+    {
+        return -1;
+    }
+    ins->opcode_str = mnemonic->name;
+    ins->opcode = mnemonic->opcode;
+
+    ins->info = APEX_get_opcode_info(ins->opcode);
+    assert(ins->info && "Opcode missing from the descriptor table");
+
+    /* Operands are parsed in the order given by the opcode descriptor;
+     * empty ones between consecutive commas are skipped */
+    p = operands;
+    end = operands + operands_len;
+    for (i = 0; i < 3; ++i)
+    {
+        while (p < end && *p == ',')
+        {
+            p++;
+        }
+        if (p == end)
+        {
+            break;
+        }
+        token = p;
+        while (p < end && *p != ',')
+        {
+            p++;
+        }
+
+        field = NULL;
+        switch (ins->info->operands[i])
+        {
+        case OPERAND_RD:
+        {
+            field = &ins->rd;
+            break;
+        }
+
+        case OPERAND_RS1:
+        {
+            field = &ins->rs1;
+            break;
+        }
+
+        case OPERAND_RS2:
+        {
+            field = &ins->rs2;
+            break;
+        }
+
+        case OPERAND_IMM:
+        {
+            ins->imm = get_num_from_token(token, p);
+            break;
+        }
+        }
+
+        if (field)
+        {
+            reg = get_register_from_token(token, p);
+            if (reg < 0)
+            {
+                return -2;
+            }
+            *field = reg;
+        }
+    }
+
+    set_register_masks(ins);
+    return 0;
+}
+
+/*
+ * Files such as test_cases.asm hold several programs, each after a
+ * ---TC n--- header. Any line starting with --- begins a new section;
+ * blank lines are ignored. Sections without instructions (a lone header
+ * or a banner line) are not counted, so section n is the n-th program of
+ * the file. A file without headers is a single section.
+ */
+typedef struct Section_Scan
+{
+    int count;                     /* Nonempty sections finished so far */
+    int insns;                     /* Instructions in the current section */
+    char name[SECTION_NAME_SIZE];  /* Header of the current section */
+} Section_Scan;
+
+/* Copies the len characters of a header line without its dashes and
+ * surrounding blanks */
+static void
+get_section_name(const char *line, size_t len, char *name)
+{
+    const char *end = line + len;
+    size_t name_len = 0;
+
+    while (line < end && (*line == '-' || *line == ' ' || *line == '\t'))
+    {
+        line++;
+    }
+    while (line + name_len < end && line[name_len] != '-' && line[name_len] != '\r'
+           && line[name_len] != '\0')
+    {
+        name_len++;
+    }
+    while (name_len > 0 && (line[name_len - 1] == ' ' || line[name_len - 1] == '\t'))
+    {
+        name_len--;
+    }
+    if (name_len >= SECTION_NAME_SIZE)
+    {
+        name_len = SECTION_NAME_SIZE - 1;
+    }
+    memcpy(name, line, name_len);
+    name[name_len] = '\0';
+}
+
+/* Returns the section of the instruction line of len characters, or -1 for
+ * headers and blank lines */
+static int
+scan_line(Section_Scan *scan, const char *line, size_t len)
+{
+    size_t i;
+
+    if (len >= 3 && line[0] == '-' && line[1] == '-' && line[2] == '-')
+    {
+        if (scan->insns)
+        {
+            scan->count++;
+            scan->insns = 0;
+        }
+        get_section_name(line, len, scan->name);
+        return -1;
+    }
+
+    for (i = 0; i < len && (line[i] == ' ' || line[i] == '\t' || line[i] == '\r'); ++i)
+    {
+    }
+    if (i == len || line[i] == '\0')
+    {
+        return -1;
+    }
+
+    scan->insns++;
+    return scan->count;
+}
+
+/*
+ * Fills names with the header of each program section of filename, at
+ * most max of them. A section without a header gets an empty name.
+ *
+ * Returns the number of sections, or -1 if the file can not be read
+ */
+int
+get_code_sections(const char *filename, char names[][SECTION_NAME_SIZE], int max)
+{
+    const APEX_Binary_Header *header;
+    Source_File src;
+    Section_Scan scan;
+    const char *line;
+    size_t pos = 0;
+    size_t len;
+    uint32_t i;
+    int section;
+
+    if (open_source(filename, &src) != 0)
+    {
+        return -1;
+    }
+
+    /* An image holds one program, named by the symbol at its first
+     * instruction */
+    if (is_binary_image(&src))
+    {
+        header = get_binary_header(&src, filename);
+        if (header && max > 0)
+        {
+            names[0][0] = '\0';
+            for (i = 0; i < header->symbol_count; ++i)
+            {
+                if (binary_symbols(header)[i].addr == 4000)
+                {
+                    snprintf(names[0], SECTION_NAME_SIZE, "%.*s", SECTION_NAME_SIZE - 1,
+                             binary_symbols(header)[i].name);
+                    break;
+                }
+            }
+        }
+        close_source(&src);
+        return header ? 1 : -1;
+    }
+
+    memset(&scan, 0, sizeof(scan));
+    while ((line = next_line(&src, &pos, &len)) != NULL)
+    {
+        section = scan_line(&scan, line, len);
+        if (section >= 0 && scan.insns == 1 && section < max)
+        {
+            strcpy(names[section], scan.name);
+        }
+    }
+
+    close_source(&src);
+    return scan.count + (scan.insns > 0);
+}
+
+/*
+ * Line numbers, counted from 1, of the instructions in the given section of
+ * filename, in code memory order; size is set to their number.
+ *
+ * Returns NULL if the file can not be read, the section is empty or the file
+ * is a program image, which has no source lines
+ */
+int *
+get_code_lines(const char *filename, int section, int *size)
+{
+    Source_File src;
+    Section_Scan scan;
+    const char *line;
+    size_t pos = 0;
+    size_t len;
+    int *lines = NULL;
+    int *grown;
+    int capacity = 0;
+    int line_num = 0;
+
+    *size = 0;
+    if (open_source(filename, &src) != 0)
+    {
+        return NULL;
+    }
+    if (is_binary_image(&src))
+    {
+        close_source(&src);
+        return NULL;
+    }
+
+    memset(&scan, 0, sizeof(scan));
+    while ((line = next_line(&src, &pos, &len)) != NULL && scan.count <= section)
+    {
+        line_num++;
+        if (scan_line(&scan, line, len) != section)
+        {
+            continue;
+        }
+
+        if (*size == capacity)
+        {
+            capacity = capacity ? 2 * capacity : 64;
+            grown = realloc(lines, capacity * sizeof(int));
+            if (!grown)
+            {
+                free(lines);
+                lines = NULL;
+                *size = 0;
+                break;
+            }
+            lines = grown;
+        }
+        lines[(*size)++] = line_num;
+    }
+
+    close_source(&src);
+    return lines;
+}
+
+/*
+ * Expands the instructions of a program image into code memory, listing
+ * each under the first mnemonic of its opcode.
+ * Returns NULL if the image is empty or holds an unknown opcode
+ */
+static APEX_Instruction *
+create_code_memory_from_image(const APEX_Binary_Header *header, const char *filename,
+                              int *size)
+{
+    const APEX_Binary_Insn *insns = binary_insns(header);
+    const char *names[NUM_OPCODES];
+    APEX_Instruction *code_memory;
+    APEX_Instruction *ins;
+    uint32_t i;
+
+    if (header->insn_count == 0 || header->insn_count >= INT_MAX)
+    {
+        return NULL;
+    }
+    code_memory = malloc((header->insn_count + 1) * sizeof(APEX_Instruction));
+    if (!code_memory)
+    {
+        return NULL;
+    }
+
+    for (i = 0; i < NUM_OPCODES; ++i)
+    {
+        names[i] = get_opcode_name(i);
+    }
+
+    for (i = 0; i < header->insn_count; ++i)
+    {
+        if (insns[i].opcode >= NUM_OPCODES || !names[insns[i].opcode])
+        {
+            fprintf(stderr, "APEX_Error: %s instruction %u: unknown opcode %d\n", filename, i,
+                    insns[i].opcode);
+            free(code_memory);
+            return NULL;
+        }
+        if (insns[i].rd >= REG_FILE_SIZE || insns[i].rs1 >= REG_FILE_SIZE
+            || insns[i].rs2 >= REG_FILE_SIZE)
+        {
+            fprintf(stderr, "APEX_Error: %s instruction %u: register out of range\n", filename,
+                    i);
+            free(code_memory);
+            return NULL;
+        }
+
+        ins = &code_memory[i];
+        memset(ins, 0, sizeof(APEX_Instruction));
+        ins->opcode_str = names[insns[i].opcode];
+        ins->opcode = insns[i].opcode;
+        ins->rd = insns[i].rd;
+        ins->rs1 = insns[i].rs1;
+        ins->rs2 = insns[i].rs2;
+        ins->imm = insns[i].imm;
+        ins->info = APEX_get_opcode_info(ins->opcode);
+        set_register_masks(ins);
+    }
+    set_end_of_code(&code_memory[header->insn_count]);
+
+    *size = header->insn_count;
+    return code_memory;
+}
+
+/*
+ * This function is related to parsing input file
+ *
+ * Loads the program in the given section of the file, see get_code_sections,
+ * in a single pass: code memory grows as instructions are parsed, and lines
+ * past the section are not read. A program image has a single section.
+ */
+APEX_Instruction *
+create_code_memory(const char *filename, int section, int *size)
+{
+    Source_File src;
+    Section_Scan scan;
+    const char *line;
+    size_t pos = 0;
+    size_t len;
+    int capacity = 0;
+    int current_instruction = 0;
+    int line_num = 0;
+    int status;
+    const APEX_Binary_Header *header;
+    APEX_Instruction *code_memory = NULL;
+    APEX_Instruction *grown;
+
+    *size = 0;
+    if (!filename || open_source(filename, &src) != 0)
+    {
+        return NULL;
+    }
+
+    if (is_binary_image(&src))
+    {
+        header = get_binary_header(&src, filename);
+        code_memory = header && section == 0
+                          ? create_code_memory_from_image(header, filename, size)
+                          : NULL;
+        close_source(&src);
+        return code_memory;
+    }
+
+    memset(&scan, 0, sizeof(scan));
+    while ((line = next_line(&src, &pos, &len)) != NULL && scan.count <= section)
+    {
+        line_num++;
+        if (scan_line(&scan, line, len) != section)
+        {
+            continue;
+        }
+
+        /* Room is kept for the entry past the end */
+        if (current_instruction + 1 >= capacity)
+        {
+            capacity = capacity ? 2 * capacity : 256;
+            grown = realloc(code_memory, capacity * sizeof(APEX_Instruction));
+            if (!grown)
+            {
+                free(code_memory);
+                close_source(&src);
+                return NULL;
+            }
+            code_memory = grown;
+        }
+
+        memset(&code_memory[current_instruction], 0, sizeof(APEX_Instruction));
+        status = create_APEX_instruction(&code_memory[current_instruction], line, len);
+        if (status != 0)
+        {
+            fprintf(stderr, "APEX_Error: %s line %d: %s\n", filename, line_num,
+                    status == -2 ? "register out of range" : "unknown instruction");
+            free(code_memory);
+            close_source(&src);
+            return NULL;
+        }
+        current_instruction++;
+    }
+    close_source(&src);
+
+    *size = current_instruction;
+    if (!current_instruction)
+    {
+        return NULL;
+    }
+
+    set_end_of_code(&code_memory[current_instruction]);
+    return code_memory;
+}
+
+/*
+ * Sets data to a copy of the data memory words a program image sets before
+ * it starts, to be freed by the caller; text programs set none.
+ *
+ * Returns the number of words, or -1 if the file can not be read or a word
+ * is outside data memory
+ */
+int
+get_data_memory_init(const char *filename, APEX_Binary_Data **data)
+{
+    const APEX_Binary_Header *header;
+    Source_File src;
+    int count = 0;
+    uint32_t i;
+
+    *data = NULL;
+    if (open_source(filename, &src) != 0)
+    {
+        return -1;
+    }
+    if (!is_binary_image(&src))
+    {
+        close_source(&src);
+        return 0;
+    }
+
+    header = get_binary_header(&src, filename);
+    if (!header)
+    {
+        count = -1;
+    }
+    else if (header->data_count > 0)
+    {
+        *data = malloc(header->data_count * sizeof(APEX_Binary_Data));
+        count = *data ? (int)header->data_count : -1;
+        for (i = 0; *data && i < header->data_count; ++i)
+        {
+            (*data)[i] = binary_data(header)[i];
+            if ((*data)[i].addr < 0 || (*data)[i].addr >= DATA_MEMORY_SIZE)
+            {
+                fprintf(stderr, "APEX_Error: %s sets data memory outside 0-%d\n", filename,
+                        DATA_MEMORY_SIZE - 1);
+                free(*data);
+                *data = NULL;
+                count = -1;
+            }
+        }
+    }
+
+    close_source(&src);
+    return count;
+}
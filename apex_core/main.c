@@ -0,0 +1,769 @@
+/*
+ * main.c
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "apex_cpu.h"
+
+static void
+print_usage(const char *prog)
+{
+    fprintf(stderr,
+            "APEX_Help: Usage %s <input_file> [simulate <n>] [fastforward <n>] "
+            "[fastforward_pc <pc>] [sample <period>] [sample_unit <n>] "
+            "[sample_warmup <n>] [checkpoint <file>] [restore <file>] "
+            "[intervals <n>] [interval_warmup <n>] [threads <n>] [verify <0|1>] "
+            "[ffbench <n>] [parsebench <n>] [dbt <0|1>] [lockstep <lanes>] [lockstep_seed <n>] "
+            "[pipeline <policy>] [trace <file>] [async_log <0|1>] [mem_delta <0|1>] "
+            "[log <0|1|2>] [display_from <cycle>] [display_to <cycle>] [single_step <0|1>] "
+            "[counters <file>] [profile <file>] [state <file>]\n"
+            "APEX_Help: Usage %s batch <directory|manifest|file.asm> [simulate <n>] [threads <n>] "
+            "[pipeline <policy>]\n"
+            "APEX_Help: Usage %s sweep <directory|manifest|file.asm> <grid> [csv <file>] "
+            "[simulate <n>] [threads <n>] [pipeline <policy>]\n"
+            "APEX_Help: Usage %s selfbench <directory|manifest|file.asm> [csv <file>] "
+            "[simulate <n>] [trials <n>] [warmup <n>]\n"
+            "APEX_Help: Pipeline policies: stalling, forwarding, bypass (default %s)\n",
+            prog, prog, prog, prog, APEX_hazard_name(DEFAULT_HAZARD_POLICY));
+}
+
+static double
+wall_seconds()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Parallel interval simulation, optionally checked against a serial
+ * detailed run of the same program */
+static int
+run_intervals(APEX_CPU *cpu, const char *filename, long interval, long warmup,
+              int threads, int verify)
+{
+    APEX_Interval_Stats stats;
+    APEX_CPU *ref;
+    double start, parallel_time, serial_time;
+
+    start = wall_seconds();
+    if (APEX_cpu_run_intervals(cpu, interval, warmup, threads, &stats) != 0)
+    {
+        fprintf(stderr, "APEX_Error: Unable to start interval simulation\n");
+        return 1;
+    }
+    parallel_time = wall_seconds() - start;
+
+    printf("APEX_CPU: Interval simulation, intervals = %ld threads = %d instructions = %ld\n",
+           stats.intervals, threads, stats.insns);
+    printf("APEX_CPU: Estimated cycles = %ld, %.3f s\n", stats.est_cycles, parallel_time);
+
+    if (!verify)
+    {
+        return 0;
+    }
+
+    ref = APEX_cpu_init(filename);
+    if (!ref)
+    {
+        fprintf(stderr, "APEX_Error: Unable to initialize CPU\n");
+        return 1;
+    }
+    ref->log_level = LOG_QUIET;
+    APEX_cpu_set_hazard(ref, cpu->hazard);
+    start = wall_seconds();
+    while (!APEX_cpu_step(ref))
+    {
+    }
+    serial_time = wall_seconds() - start;
+
+    printf("APEX_CPU: Serial cycles = %d, %.3f s, error = %+.3f%%, speedup = %.2fx\n",
+           ref->clock, serial_time,
+           ref->clock ? 100.0 * (stats.est_cycles - ref->clock) / ref->clock : 0.0,
+           parallel_time > 0 ? serial_time / parallel_time : 0.0);
+    APEX_cpu_stop(ref);
+    return 0;
+}
+
+/* Fills data memory with small values drawn from seed, the input data set
+ * of one lockstep lane */
+static void
+fill_data_memory(APEX_CPU *cpu, unsigned int seed)
+{
+    int i;
+
+    for (i = 0; i < DATA_MEMORY_SIZE; ++i)
+    {
+        seed = seed * 1103515245u + 12345u;
+        cpu->data_memory[i] = (seed >> 16) % 256;
+    }
+    APEX_cpu_index_memory(cpu);
+}
+
+/* Runs lanes copies of the program in the lockstep engine, lane i with data
+ * memory filled from seed + i (all zero without a seed), and optionally
+ * checks every lane against a scalar CPU with the same hazard policy */
+static int
+run_lockstep(const char *filename, int lanes, unsigned int seed, int hazard, int max_cycles,
+             int verify)
+{
+    APEX_Lockstep *ls;
+    APEX_CPU *cpu, *ref;
+    double start, lockstep_time, serial_time;
+    long lane_cycles = 0;
+    int halted, lane, mismatches = 0;
+
+    ls = APEX_lockstep_create(filename, 0, lanes, hazard);
+    cpu = APEX_cpu_create(filename, 0, NULL);
+    if (!ls || !cpu)
+    {
+        fprintf(stderr, "APEX_Error: Unable to initialize CPU\n");
+        exit(1);
+    }
+    for (lane = 0; seed && lane < lanes; ++lane)
+    {
+        fill_data_memory(cpu, seed + lane);
+        APEX_lockstep_set_lane(ls, lane, cpu);
+    }
+
+    start = wall_seconds();
+    halted = APEX_lockstep_run(ls, max_cycles);
+    lockstep_time = wall_seconds() - start;
+    if (halted < 0)
+    {
+        fprintf(stderr, "APEX_Error: Out of memory in lockstep simulation\n");
+        exit(1);
+    }
+    for (lane = 0; lane < lanes; ++lane)
+    {
+        APEX_lockstep_get_lane(ls, lane, cpu);
+        lane_cycles += cpu->clock;
+    }
+
+    printf("APEX_CPU: Lockstep simulation, lanes = %d halted = %d, peak groups = %d, "
+           "lane cycles = %ld, %.3f s, %.2f M lane cycles/s\n",
+           lanes, halted, APEX_lockstep_peak_groups(ls), lane_cycles, lockstep_time,
+           lockstep_time > 0 ? lane_cycles / lockstep_time / 1e6 : 0.0);
+
+    if (verify)
+    {
+        serial_time = 0;
+        for (lane = 0; lane < lanes; ++lane)
+        {
+            ref = APEX_cpu_create(filename, 0, NULL);
+            if (!ref)
+            {
+                fprintf(stderr, "APEX_Error: Unable to initialize CPU\n");
+                exit(1);
+            }
+            APEX_cpu_set_hazard(ref, hazard);
+            if (seed)
+            {
+                fill_data_memory(ref, seed + lane);
+            }
+            start = wall_seconds();
+            APEX_cpu_step_until(ref, max_cycles);
+            serial_time += wall_seconds() - start;
+
+            APEX_lockstep_get_lane(ls, lane, cpu);
+            if (cpu->clock != ref->clock || cpu->insn_completed != ref->insn_completed
+                || memcmp(cpu->regs, ref->regs, sizeof(cpu->regs)) != 0
+                || memcmp(cpu->data_memory, ref->data_memory, sizeof(cpu->data_memory)) != 0
+                || cpu->zero_flag != ref->zero_flag || cpu->positive_flag != ref->positive_flag
+                || cpu->negative_flag != ref->negative_flag)
+            {
+                mismatches++;
+            }
+            APEX_cpu_stop(ref);
+        }
+        printf("APEX_CPU: Scalar simulation, %.3f s, speedup = %.2fx, mismatched lanes = %d\n",
+               serial_time, lockstep_time > 0 ? serial_time / lockstep_time : 0.0, mismatches);
+    }
+
+    APEX_cpu_stop(cpu);
+    APEX_lockstep_free(ls);
+    return mismatches ? 1 : 0;
+}
+
+/* Runs the program n times in the functional model and reports its
+ * throughput in simulated MIPS */
+static void
+run_functional_bench(APEX_CPU *cpu, long reps)
+{
+    double start, seconds;
+    long r;
+
+    start = wall_seconds();
+    for (r = 0; r < reps; ++r)
+    {
+        cpu->pc = 4000;
+        memset(cpu->regs, 0, sizeof(cpu->regs));
+        cpu->zero_flag = FALSE;
+        cpu->positive_flag = FALSE;
+        cpu->negative_flag = FALSE;
+        APEX_cpu_fast_forward(cpu, -1, -1);
+    }
+    seconds = wall_seconds() - start;
+
+    printf("APEX_CPU: Functional benchmark, %s, instructions = %ld, %.3f s, %.1f MIPS\n",
+           cpu->use_dbt ? "binary translation" : APEX_cpu_dispatch_name(), cpu->functional_insns, seconds,
+           seconds > 0 ? cpu->functional_insns / seconds / 1e6 : 0.0);
+}
+
+/* Parses the first program of the input file (or loads the program image)
+ * n times and reports the throughput in bytes of input and instructions
+ * per second */
+static int
+run_parse_bench(const char *filename, long reps)
+{
+    APEX_Instruction *code_memory;
+    struct stat st;
+    double start, seconds;
+    long insns = 0;
+    long r;
+    int size;
+
+    if (stat(filename, &st) != 0)
+    {
+        fprintf(stderr, "APEX_Error: Unable to read %s\n", filename);
+        return 1;
+    }
+
+    start = wall_seconds();
+    for (r = 0; r < reps; ++r)
+    {
+        code_memory = create_code_memory(filename, 0, &size);
+        if (!code_memory)
+        {
+            fprintf(stderr, "APEX_Error: Unable to parse %s\n", filename);
+            return 1;
+        }
+        free(code_memory);
+        insns += size;
+    }
+    seconds = wall_seconds() - start;
+
+    printf("APEX_CPU: Parse benchmark, bytes = %lld instructions = %d, %.3f s, %.1f MB/s, "
+           "%.2f M instructions/s\n",
+           (long long)st.st_size, size, seconds,
+           seconds > 0 ? reps * (double)st.st_size / seconds / 1e6 : 0.0,
+           seconds > 0 ? insns / seconds / 1e6 : 0.0);
+    return 0;
+}
+
+int
+main(int argc, char const *argv[])
+{
+    APEX_CPU *cpu;
+    int cycles = 5000;
+    long ff_insns = -1;
+    int ff_pc = -1;
+    long sample_period = -1;
+    long sample_unit = 100;
+    long sample_warmup = 20;
+    const char *checkpoint_file = NULL;
+    const char *restore_file = NULL;
+    long interval = -1;
+    long interval_warmup = 100;
+    int threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int verify = 0;
+    long ffbench = 0;
+    long parsebench = 0;
+    int dbt = 0;
+    int lockstep = 0;
+    unsigned int lockstep_seed = 0;
+    const char *batch = NULL;
+    const char *sweep_grid = NULL;
+    int selfbench = FALSE;
+    int trials = 15;
+    int warmup = 3;
+    const char *csv_file = NULL;
+    const char *trace_file = NULL;
+    int async_log = 1;
+    int mem_delta = 0;
+    int log_level = -1;
+    int display_from = 0;
+    int display_to = INT_MAX;
+    int single_step = FALSE;
+    const char *counters_file = NULL;
+    const char *profile_file = NULL;
+    const char *state_file = NULL;
+    int halted = FALSE;
+    APEX_Log *log = NULL;
+    int hazard = -1;
+    int first = 2;
+    int i;
+
+    fprintf(stderr, "APEX CPU Pipeline Simulator\n");
+
+    if (argc >= 3 && strcmp(argv[1], "batch") == 0)
+    {
+        batch = argv[2];
+        first = 3;
+    }
+    else if (argc >= 4 && strcmp(argv[1], "sweep") == 0)
+    {
+        batch = argv[2];
+        sweep_grid = argv[3];
+        first = 4;
+    }
+    else if (argc >= 3 && strcmp(argv[1], "selfbench") == 0)
+    {
+        batch = argv[2];
+        selfbench = TRUE;
+        first = 3;
+    }
+
+    if (argc < 2 || (argc - first) % 2 != 0)
+    {
+        print_usage(argv[0]);
+        exit(1);
+    }
+
+    for (i = first; i < argc; i += 2)
+    {
+        if (strcmp(argv[i], "simulate") == 0)
+        {
+            cycles = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "fastforward") == 0)
+        {
+            ff_insns = atol(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "fastforward_pc") == 0)
+        {
+            ff_pc = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "sample") == 0)
+        {
+            sample_period = atol(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "sample_unit") == 0)
+        {
+            sample_unit = atol(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "sample_warmup") == 0)
+        {
+            sample_warmup = atol(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "checkpoint") == 0)
+        {
+            checkpoint_file = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "restore") == 0)
+        {
+            restore_file = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "intervals") == 0)
+        {
+            interval = atol(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "interval_warmup") == 0)
+        {
+            interval_warmup = atol(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "threads") == 0)
+        {
+            threads = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "verify") == 0)
+        {
+            verify = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "ffbench") == 0)
+        {
+            ffbench = atol(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "parsebench") == 0)
+        {
+            parsebench = atol(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "dbt") == 0)
+        {
+            dbt = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "lockstep") == 0)
+        {
+            lockstep = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "lockstep_seed") == 0)
+        {
+            lockstep_seed = strtoul(argv[i + 1], NULL, 0);
+        }
+        else if (strcmp(argv[i], "trials") == 0)
+        {
+            trials = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "warmup") == 0)
+        {
+            warmup = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "csv") == 0)
+        {
+            csv_file = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "async_log") == 0)
+        {
+            async_log = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "log") == 0)
+        {
+            log_level = atoi(argv[i + 1]);
+            if (log_level < LOG_QUIET || log_level > LOG_PIPELINE)
+            {
+                print_usage(argv[0]);
+                exit(1);
+            }
+        }
+        else if (strcmp(argv[i], "display_from") == 0)
+        {
+            display_from = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "display_to") == 0)
+        {
+            display_to = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "single_step") == 0)
+        {
+            single_step = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "counters") == 0)
+        {
+            counters_file = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "profile") == 0)
+        {
+            profile_file = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "state") == 0)
+        {
+            state_file = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "mem_delta") == 0)
+        {
+            mem_delta = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "trace") == 0)
+        {
+            trace_file = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "pipeline") == 0)
+        {
+            hazard = APEX_hazard_from_string(argv[i + 1]);
+            if (hazard < 0)
+            {
+                print_usage(argv[0]);
+                exit(1);
+            }
+        }
+        else
+        {
+            print_usage(argv[0]);
+            exit(1);
+        }
+    }
+
+    if (batch)
+    {
+        double start = wall_seconds();
+        int failed;
+
+        if (threads <= 0 || cycles <= 0 || trials <= 0 || warmup < 0)
+        {
+            print_usage(argv[0]);
+            exit(1);
+        }
+        if (selfbench)
+        {
+            FILE *csv = csv_file ? fopen(csv_file, "w") : stdout;
+
+            if (!csv)
+            {
+                fprintf(stderr, "APEX_Error: Unable to write %s\n", csv_file);
+                exit(1);
+            }
+            failed = APEX_selfbench_run(batch, trials, warmup, cycles, csv);
+            if (csv != stdout)
+            {
+                fclose(csv);
+            }
+            if (failed < 0)
+            {
+                fprintf(stderr, "APEX_Error: Unable to benchmark %s\n", batch);
+                exit(1);
+            }
+            fprintf(stderr, "APEX_CPU: Self-benchmark wall time = %.3f s\n",
+                    wall_seconds() - start);
+            return failed ? 1 : 0;
+        }
+        if (sweep_grid)
+        {
+            FILE *csv = csv_file ? fopen(csv_file, "w") : stdout;
+
+            if (!csv)
+            {
+                fprintf(stderr, "APEX_Error: Unable to write %s\n", csv_file);
+                exit(1);
+            }
+            failed = APEX_sweep_run(batch, sweep_grid,
+                                    hazard < 0 ? DEFAULT_HAZARD_POLICY : hazard, threads,
+                                    cycles, csv);
+            if (csv != stdout)
+            {
+                fclose(csv);
+            }
+            if (failed < 0)
+            {
+                exit(1);
+            }
+            fprintf(stderr, "APEX_CPU: Sweep wall time = %.3f s on %d threads\n",
+                    wall_seconds() - start, threads);
+            return failed ? 1 : 0;
+        }
+
+        failed = APEX_batch_run(batch, hazard < 0 ? DEFAULT_HAZARD_POLICY : hazard, threads,
+                                cycles, stdout);
+        if (failed < 0)
+        {
+            fprintf(stderr, "APEX_Error: Unable to read %s\n", batch);
+            exit(1);
+        }
+        printf("APEX_CPU: Batch wall time = %.3f s on %d threads\n", wall_seconds() - start,
+               threads);
+        return failed ? 1 : 0;
+    }
+
+    if (parsebench > 0)
+    {
+        return run_parse_bench(argv[1], parsebench);
+    }
+
+    if (lockstep > 0)
+    {
+        return run_lockstep(argv[1], lockstep, lockstep_seed,
+                            hazard < 0 ? DEFAULT_HAZARD_POLICY : hazard, cycles, verify);
+    }
+
+    if (restore_file)
+    {
+        cpu = APEX_cpu_restore(restore_file);
+        if (cpu && strcmp(cpu->filename, argv[1]) != 0)
+        {
+            fprintf(stderr, "APEX_Error: %s was saved from %s\n", restore_file,
+                    cpu->filename);
+            APEX_cpu_stop(cpu);
+            exit(1);
+        }
+    }
+    else
+    {
+        cpu = APEX_cpu_init(argv[1]);
+    }
+
+    if (!cpu)
+    {
+        fprintf(stderr, "APEX_Error: Unable to initialize CPU\n");
+        exit(1);
+    }
+
+    cpu->mem_delta_view = mem_delta;
+    cpu->use_dbt = dbt;
+    if (log_level >= 0)
+    {
+        cpu->log_level = log_level;
+    }
+    cpu->display_from = display_from;
+    cpu->display_to = display_to;
+    cpu->single_step = single_step;
+
+    /* A restored CPU keeps the policy it was saved with unless one is given */
+    if (hazard >= 0)
+    {
+        APEX_cpu_set_hazard(cpu, hazard);
+    }
+
+    if ((sample_period >= 0 && (sample_unit <= 0 || sample_warmup < 0))
+        || (interval >= 0 && (interval == 0 || interval_warmup < 0 || threads <= 0)))
+    {
+        print_usage(argv[0]);
+        exit(1);
+    }
+
+    APEX_cpu_print_code_memory(cpu);
+
+    if (ff_insns >= 0 || ff_pc >= 0)
+    {
+        if (APEX_cpu_fast_forward(cpu, ff_insns, ff_pc))
+        {
+            printf("APEX_CPU: Simulation Complete in fast-forward, instructions = %ld\n",
+                   cpu->functional_insns);
+            halted = TRUE;
+            goto outputs;
+        }
+        fprintf(stderr,
+                "APEX_CPU: Fast-forwarded %ld instructions, switching to pipeline at pc %d\n",
+                cpu->functional_insns, cpu->pc);
+    }
+
+    if (ffbench > 0)
+    {
+        run_functional_bench(cpu, ffbench);
+        APEX_cpu_stop(cpu);
+        return 0;
+    }
+
+    if (interval > 0)
+    {
+        int ret = run_intervals(cpu, argv[1], interval, interval_warmup, threads, verify);
+
+        APEX_cpu_stop(cpu);
+        return ret;
+    }
+
+    if (sample_period >= 0)
+    {
+        APEX_Sample_Stats stats;
+
+        APEX_cpu_run_sampled(cpu, sample_period, sample_unit, sample_warmup, &stats);
+        printf("APEX_CPU: Sampled simulation, samples = %ld instructions = %ld\n",
+               stats.samples, stats.insns);
+        if (stats.samples > 1)
+        {
+            printf("APEX_CPU: CPI = %.4f +/- %.4f (95%% confidence), estimated cycles = %.0f\n",
+                   stats.cpi_mean, stats.cpi_ci95, stats.est_cycles);
+        }
+        else if (stats.samples == 1)
+        {
+            printf("APEX_CPU: CPI = %.4f (single sample, no confidence interval), "
+                   "estimated cycles = %.0f\n",
+                   stats.cpi_mean, stats.est_cycles);
+        }
+        else
+        {
+            printf("APEX_CPU: No complete sample, use a smaller period or unit\n");
+        }
+        APEX_cpu_stop(cpu);
+        return 0;
+    }
+
+    if (trace_file)
+    {
+        cpu->trace = APEX_trace_open(trace_file, cpu);
+        if (!cpu->trace)
+        {
+            fprintf(stderr, "APEX_Error: Unable to write trace %s\n", trace_file);
+            APEX_cpu_stop(cpu);
+            exit(1);
+        }
+        /* The trace replaces the per-cycle text, see apex_trace_decode */
+        cpu->log_level = LOG_QUIET;
+    }
+    else if (async_log && cpu->log_level != LOG_QUIET && !cpu->single_step)
+    {
+        /* The per-cycle text is written by a background thread; without
+         * one, it is printed directly */
+        log = APEX_log_open(stdout);
+        if (log)
+        {
+            cpu->out = APEX_log_stream(log);
+        }
+    }
+
+outputs:
+    /* A program that halted in fast-forward has an empty profile */
+    if (profile_file && APEX_cpu_enable_profile(cpu) != 0)
+    {
+        fprintf(stderr, "APEX_Error: Unable to start the profile\n");
+        profile_file = NULL;
+    }
+
+    if (!halted)
+    {
+        halted = APEX_cpu_run(cpu, cycles);
+    }
+
+    if (log)
+    {
+        cpu->out = stdout;
+        if (APEX_log_close(log) != 0)
+        {
+            fprintf(stderr, "APEX_Error: Unable to write the simulation output\n");
+        }
+    }
+
+    if (cpu->trace)
+    {
+        if (APEX_trace_close(cpu->trace) != 0)
+        {
+            fprintf(stderr, "APEX_Error: Unable to write trace %s\n", trace_file);
+        }
+        cpu->trace = NULL;
+    }
+
+    if (counters_file)
+    {
+        FILE *fp = strcmp(counters_file, "-") == 0 ? stdout : fopen(counters_file, "w");
+
+        if (!fp || APEX_cpu_write_counters(cpu, halted, fp) != 0
+            || (fp != stdout && fclose(fp) != 0))
+        {
+            fprintf(stderr, "APEX_Error: Unable to write counters %s\n", counters_file);
+        }
+    }
+
+    if (state_file)
+    {
+        FILE *fp = strcmp(state_file, "-") == 0 ? stdout : fopen(state_file, "w");
+        FILE *out = cpu->out;
+
+        /* The final state in the format of the per-cycle output, with
+         * every nonzero data memory word */
+        if (fp)
+        {
+            cpu->out = fp;
+            cpu->mem_delta_view = FALSE;
+            APEX_cpu_print_state(cpu);
+            cpu->out = out;
+        }
+        if (!fp || ferror(fp) || (fp != stdout && fclose(fp) != 0))
+        {
+            fprintf(stderr, "APEX_Error: Unable to write state %s\n", state_file);
+        }
+    }
+
+    if (profile_file)
+    {
+        FILE *fp = strcmp(profile_file, "-") == 0 ? stdout : fopen(profile_file, "w");
+
+        if (!fp || APEX_cpu_write_profile(cpu, 0, fp) != 0
+            || (fp != stdout && fclose(fp) != 0))
+        {
+            fprintf(stderr, "APEX_Error: Unable to write profile %s\n", profile_file);
+        }
+    }
+
+    if (checkpoint_file)
+    {
+        if (APEX_cpu_save(cpu, checkpoint_file) != 0)
+        {
+            fprintf(stderr, "APEX_Error: Unable to write checkpoint %s\n", checkpoint_file);
+            APEX_cpu_stop(cpu);
+            exit(1);
+        }
+        fprintf(stderr, "APEX_CPU: Checkpoint written to %s at cycle %d\n", checkpoint_file,
+                cpu->clock);
+    }
+
+    APEX_cpu_stop(cpu);
+    return 0;
+}